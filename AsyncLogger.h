@@ -0,0 +1,379 @@
+// AsyncLogger.h : asynchronous console logger shared by the assignment programs.
+//
+// log_info / log_error copy their arguments into a per-thread lock-free ring buffer and return
+// immediately; a background thread formats them with operator<< and writes them to std::cout /
+// std::cerr, flushing once per batch instead of once per line like std::endl.
+// Lines from one thread keep their order; lines from different threads are not globally ordered.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// where a log line goes: info to std::cout, error to std::cerr
+/// </summary>
+enum class log_level
+{
+    info,
+    error
+};
+
+/// <summary>
+/// arguments are stored by value until the drain thread formats them. character pointers are
+/// copied into std::string because they usually point at buffers (exception::what()) that will
+/// be gone by then.
+/// </summary>
+template <typename T>
+using log_argument_t = std::conditional_t<
+    std::is_convertible<std::decay_t<T>, const char*>::value && std::is_pointer<std::decay_t<T>>::value,
+    std::string, std::decay_t<T>>;
+
+/// <summary>
+/// one queued log line: the captured arguments and the function that formats and destroys them
+/// </summary>
+struct log_record
+{
+    static constexpr size_t storage_size = 240;
+
+    void (*format)(void* storage, std::ostream& output) = nullptr;
+    log_level level = log_level::info;
+    alignas(std::max_align_t) unsigned char storage[storage_size];
+};
+
+/// <summary>
+/// single producer / single consumer ring owned by one logging thread and read by the drain thread
+/// </summary>
+struct log_ring
+{
+    // power of two so positions wrap with a mask
+    static constexpr size_t capacity = 1024;
+
+    // producer and consumer positions on separate cache lines
+    alignas(64) std::atomic<size_t> head{ 0 };
+    alignas(64) std::atomic<size_t> tail{ 0 };
+    // set when the owning thread exits; the drain thread drops the ring once it is empty
+    std::atomic<bool> retired{ false };
+    std::array<log_record, capacity> records;
+
+    // nothing more will be written and everything written has been drained
+    bool finished() const
+    {
+        return retired.load(std::memory_order_acquire) &&
+            head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+};
+
+/// <summary>
+/// process wide logger; created on first use, drained and joined at exit
+/// </summary>
+class async_logger
+{
+public:
+    static async_logger& instance()
+    {
+        static async_logger logger;
+        return logger;
+    }
+
+    async_logger(const async_logger&) = delete;
+    async_logger& operator=(const async_logger&) = delete;
+
+    /// <summary>
+    /// queue one line; formatting happens later on the drain thread
+    /// </summary>
+    /// <param name="level">destination stream</param>
+    /// <param name="args">values written with operator&lt;&lt;, one after another</param>
+    template <typename... Args>
+    void write(log_level level, Args&&... args)
+    {
+        using arguments = std::tuple<log_argument_t<Args>...>;
+        static_assert(sizeof(arguments) <= log_record::storage_size, "too many log arguments for one record");
+        static_assert(alignof(arguments) <= alignof(std::max_align_t), "log argument alignment too large");
+
+        log_ring& ring = local_ring();
+        const size_t head = ring.head.load(std::memory_order_relaxed);
+
+        // a full ring means the drain thread is behind; wait for it rather than drop the line
+        while (head - ring.tail.load(std::memory_order_acquire) == log_ring::capacity) {
+            std::this_thread::yield();
+        }
+
+        log_record& record = ring.records[head & (log_ring::capacity - 1)];
+        new (record.storage) arguments(std::forward<Args>(args)...);
+        record.level = level;
+        record.format = &format_record<arguments>;
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+
+    /// <summary>
+    /// write out everything queued so far and flush both console streams
+    /// </summary>
+    void flush()
+    {
+        std::lock_guard<std::mutex> lock(drain_mutex);
+        drain_rings();
+        std::cout.flush();
+        std::cerr.flush();
+    }
+
+private:
+    using signal_handler = void (*)(int);
+
+    // signals that flush the queue before the process dies
+    static constexpr int crash_signals[] = { SIGABRT, SIGSEGV, SIGFPE, SIGILL };
+    static constexpr size_t crash_signal_count = sizeof(crash_signals) / sizeof(crash_signals[0]);
+
+    async_logger()
+    {
+        previous_terminate = std::set_terminate(&on_terminate);
+        for (size_t i = 0; i < crash_signal_count; ++i) {
+            previous_signal_handlers[i] = std::signal(crash_signals[i], &on_crash_signal);
+        }
+        drain_thread = std::thread(&async_logger::drain_loop, this);
+    }
+
+    ~async_logger()
+    {
+        running.store(false, std::memory_order_release);
+        drain_thread.join();
+        flush();
+    }
+
+    template <typename Arguments>
+    static void format_record(void* storage, std::ostream& output)
+    {
+        Arguments& arguments = *std::launder(reinterpret_cast<Arguments*>(storage));
+        std::apply([&output](const auto&... values) { (output << ... << values); }, arguments);
+        output << '\n';
+        arguments.~Arguments();
+    }
+
+    /// <summary>
+    /// marks the thread's ring retired when the thread exits
+    /// </summary>
+    struct ring_owner
+    {
+        std::shared_ptr<log_ring> ring;
+
+        ~ring_owner()
+        {
+            if (ring)
+            {
+                ring->retired.store(true, std::memory_order_release);
+            }
+        }
+    };
+
+    /// <summary>
+    /// this thread's ring, registered with the logger the first time the thread logs
+    /// </summary>
+    log_ring& local_ring()
+    {
+        thread_local ring_owner owner;
+        if (!owner.ring)
+        {
+            owner.ring = std::make_shared<log_ring>();
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            rings.push_back(owner.ring);
+        }
+        return *owner.ring;
+    }
+
+    /// <summary>
+    /// format every record queued in one ring; caller holds drain_mutex
+    /// </summary>
+    /// <param name="ring">ring to empty</param>
+    /// <param name="last_stream">stream written last, carried across rings</param>
+    /// <returns>true when anything was written</returns>
+    static bool drain_ring(log_ring& ring, std::ostream*& last_stream)
+    {
+        bool wrote = false;
+        const size_t head = ring.head.load(std::memory_order_acquire);
+        for (size_t tail = ring.tail.load(std::memory_order_relaxed); tail != head; ++tail) {
+            log_record& record = ring.records[tail & (log_ring::capacity - 1)];
+            std::ostream& stream = record.level == log_level::error ? std::cerr : std::cout;
+
+            // keep stdout and stderr lines in order relative to each other
+            if (last_stream != nullptr && last_stream != &stream)
+            {
+                last_stream->flush();
+            }
+            last_stream = &stream;
+
+            record.format(record.storage, stream);
+            ring.tail.store(tail + 1, std::memory_order_release);
+            wrote = true;
+        }
+        return wrote;
+    }
+
+    /// <summary>
+    /// format every queued record; caller holds drain_mutex
+    /// </summary>
+    /// <returns>true when anything was written</returns>
+    bool drain_rings()
+    {
+        // work on a copy so producers can register new rings while records are formatted
+        std::vector<std::shared_ptr<log_ring>> snapshot;
+        {
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            snapshot = rings;
+        }
+
+        bool wrote = false;
+        bool any_finished = false;
+        std::ostream* last_stream = nullptr;
+        for (const auto& ring : snapshot) {
+            wrote = drain_ring(*ring, last_stream) || wrote;
+            any_finished = any_finished || ring->finished();
+        }
+
+        // unregister rings of exited threads so they are freed and no longer scanned
+        if (any_finished)
+        {
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            rings.erase(std::remove_if(rings.begin(), rings.end(),
+                [](const std::shared_ptr<log_ring>& ring) { return ring->finished(); }), rings.end());
+        }
+
+        if (last_stream != nullptr)
+        {
+            last_stream->flush();
+        }
+        return wrote;
+    }
+
+    void drain_loop()
+    {
+        drain_thread_id.store(std::this_thread::get_id(), std::memory_order_release);
+        while (running.load(std::memory_order_acquire)) {
+            bool wrote;
+            {
+                std::lock_guard<std::mutex> lock(drain_mutex);
+                wrote = drain_rings();
+            }
+            if (!wrote)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+
+    /// <summary>
+    /// best effort flush while the process is dying; never blocks on either lock, since the
+    /// crash may have happened on the drain thread while it held one, or on a thread that will
+    /// never be scheduled again. the rings are walked in place so no snapshot is allocated,
+    /// which matters when the crash came from inside malloc.
+    /// </summary>
+    void crash_flush()
+    {
+        if (std::this_thread::get_id() != drain_thread_id.load(std::memory_order_acquire))
+        {
+            // give the drain thread a moment to finish the batch it is writing, then give up
+            for (int attempt = 0; attempt < 100; ++attempt) {
+                if (drain_mutex.try_lock())
+                {
+                    if (rings_mutex.try_lock())
+                    {
+                        std::ostream* last_stream = nullptr;
+                        for (const auto& ring : rings) {
+                            drain_ring(*ring, last_stream);
+                        }
+                        rings_mutex.unlock();
+                        drain_mutex.unlock();
+                        break;
+                    }
+                    drain_mutex.unlock();
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        // on the drain thread only the lines already formatted into the streams can be saved
+        std::cout.flush();
+        std::cerr.flush();
+    }
+
+    static void on_terminate()
+    {
+        instance().crash_flush();
+        if (instance().previous_terminate != nullptr)
+        {
+            instance().previous_terminate();
+        }
+        std::abort();
+    }
+
+    static void on_crash_signal(int signal_number)
+    {
+        // not async-signal-safe, but the process is going down anyway and losing the
+        // last lines before a crash is worse than the small chance of corrupt output here
+        instance().crash_flush();
+
+        // hand the signal on to whoever was installed before us; an ignored crash signal
+        // would return to the faulting instruction, so that one gets the default action
+        signal_handler previous = SIG_DFL;
+        for (size_t i = 0; i < crash_signal_count; ++i) {
+            if (crash_signals[i] == signal_number)
+            {
+                previous = instance().previous_signal_handlers[i];
+            }
+        }
+        if (previous == SIG_IGN || previous == SIG_ERR || previous == nullptr)
+        {
+            previous = SIG_DFL;
+        }
+        std::signal(signal_number, previous);
+        std::raise(signal_number);
+    }
+
+    std::mutex rings_mutex;
+    std::vector<std::shared_ptr<log_ring>> rings;
+    std::mutex drain_mutex;
+    std::atomic<bool> running{ true };
+    std::thread drain_thread;
+    std::atomic<std::thread::id> drain_thread_id{};
+    std::terminate_handler previous_terminate = nullptr;
+    signal_handler previous_signal_handlers[crash_signal_count] = {};
+};
+
+/// <summary>
+/// queue a line for std::cout
+/// </summary>
+template <typename... Args>
+void log_info(Args&&... args)
+{
+    async_logger::instance().write(log_level::info, std::forward<Args>(args)...);
+}
+
+/// <summary>
+/// queue a line for std::cerr
+/// </summary>
+template <typename... Args>
+void log_error(Args&&... args)
+{
+    async_logger::instance().write(log_level::error, std::forward<Args>(args)...);
+}
+
+/// <summary>
+/// block until every queued line has been written and the console streams are flushed
+/// </summary>
+inline void log_flush()
+{
+    async_logger::instance().flush();
+}
@@ -2,108 +2,2265 @@
 //
 
 #define _CRT_SECURE_NO_WARNINGS
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bitset>
 #include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
 #include <sstream>
 #include <ctime>
 #include <chrono>
+#include <filesystem>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "AsyncLogger.h"
+#include "HotPathTrace.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define ENCRYPTION_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// msvc allows any instruction set intrinsic without per-function opt in
+#define ENCRYPTION_TARGET(isa)
+#else
+#define ENCRYPTION_TARGET(isa) __attribute__((target(isa)))
+#endif
+#else
+#define ENCRYPTION_X86 0
+#endif
+
+std::string read_file(const std::string& filename)
+{
+    TRACE_SCOPE("read_file");
+
+    //std::string file_text = "John Q. Smith\nThis is my test string";
+    // initialize empty string
+    std::string file_text = "";
+    std::string string;
+
+    // Open a file stream with which to read the file
+    std::ifstream file_stream(filename);
+
+
+    while (std::getline(file_stream, string)) {
+        // Newline separator in file
+        file_text += string + "\n";
+    }
+
+    file_stream.close();
+    return file_text;
+}
+
+std::string get_student_name(const std::string& string_data)
+{
+    TRACE_SCOPE("get_student_name");
+
+    std::string student_name;
+
+    // find the first newline
+    size_t pos = string_data.find('\n');
+    // did we find a newline
+    if (pos != std::string::npos)
+    { // we did, so copy that substring as the student name
+        student_name = string_data.substr(0, pos);
+    }
+
+    return student_name;
+}
+
+/// <summary>
+/// crc32c (castagnoli) lookup table for the portable byte-at-a-time fallback
+/// </summary>
+static const std::array<uint32_t, 256> crc32c_table = [] {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            // reflected polynomial 0x1EDC6F41
+            crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1u)));
+        }
+        table[i] = crc;
+    }
+    return table;
+}();
+
+/// <summary>
+/// update a running crc32c one byte at a time, used when the cpu has no crc32 instruction
+/// </summary>
+/// <param name="crc">running (pre-inverted) crc</param>
+/// <param name="data">bytes to add</param>
+/// <param name="length">number of bytes</param>
+/// <returns>updated running crc</returns>
+uint32_t crc32c_portable(uint32_t crc, const char* data, size_t length)
+{
+    for (size_t i = 0; i < length; ++i) {
+        crc = crc32c_table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if ENCRYPTION_X86
+/// <summary>
+/// update a running crc32c eight bytes at a time with the sse4.2 crc32 instruction
+/// </summary>
+/// <param name="crc">running (pre-inverted) crc</param>
+/// <param name="data">bytes to add</param>
+/// <param name="length">number of bytes</param>
+/// <returns>updated running crc</returns>
+ENCRYPTION_TARGET("sse4.2") uint32_t crc32c_sse42(uint32_t crc, const char* data, size_t length)
+{
+    uint64_t crc64 = crc;
+    for (; length >= 8; data += 8, length -= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+
+    uint32_t crc32 = static_cast<uint32_t>(crc64);
+    for (; length > 0; ++data, --length) {
+        crc32 = _mm_crc32_u8(crc32, static_cast<uint8_t>(*data));
+    }
+    return crc32;
+}
+
+/// <summary>
+/// check cpuid once for the sse4.2 crc32 instruction
+/// </summary>
+/// <returns>true when crc32c_sse42 may be used</returns>
+bool cpu_has_sse42()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;
+#else
+    return __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+/// <summary>
+/// check cpuid, and that the os saves the ymm registers, for avx2
+/// </summary>
+/// <returns>true when avx2 kernels may be used</returns>
+bool cpu_has_avx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    const bool os_saves_ymm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x06) == 0x06;
+    __cpuidex(info, 7, 0);
+    return os_saves_ymm && (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+/// <summary>
+/// check cpuid, and that the os saves the zmm registers, for avx-512 foundation
+/// </summary>
+/// <returns>true when avx-512 kernels may be used</returns>
+bool cpu_has_avx512f()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    const bool os_saves_zmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0xE6) == 0xE6;
+    __cpuidex(info, 7, 0);
+    return os_saves_zmm && (info[1] & (1 << 16)) != 0;
+#else
+    return __builtin_cpu_supports("avx512f");
+#endif
+}
+#endif
+
+/// <summary>
+/// compute the crc32c of a block, using the crc32 instruction when available
+/// </summary>
+/// <param name="data">bytes to checksum</param>
+/// <param name="length">number of bytes</param>
+/// <returns>crc32c of the block</returns>
+uint32_t crc32c(const char* data, size_t length)
+{
+#if ENCRYPTION_X86
+    static const bool hardware = cpu_has_sse42();
+    if (hardware)
+    {
+        return ~crc32c_sse42(~0u, data, length);
+    }
+#endif
+    return ~crc32c_portable(~0u, data, length);
+}
+
+/// <summary>
+/// append a 32 bit value to a buffer in little-endian byte order
+/// </summary>
+/// <param name="output">buffer to append to</param>
+/// <param name="value">value to append</param>
+void put_le32(std::string& output, uint32_t value)
+{
+    output += static_cast<char>(value);
+    output += static_cast<char>(value >> 8);
+    output += static_cast<char>(value >> 16);
+    output += static_cast<char>(value >> 24);
+}
+
+/// <summary>
+/// read a little-endian 32 bit value
+/// </summary>
+/// <param name="data">first of four bytes</param>
+/// <returns>decoded value</returns>
+uint32_t get_le32(const char* data)
+{
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+/// <summary>
+/// append an lz4 sequence: a token, the literals, and (unless this is the last sequence) a match
+/// </summary>
+/// <param name="output">compressed block being built</param>
+/// <param name="literals">bytes copied verbatim</param>
+/// <param name="literal_length">number of literal bytes</param>
+/// <param name="offset">distance back to the match, 0 for the final literal-only sequence</param>
+/// <param name="match_length">match length including the 4 byte minimum</param>
+void lz4_emit_sequence(std::string& output, const char* literals, size_t literal_length, size_t offset, size_t match_length)
+{
+    const size_t match_code = offset == 0 ? 0 : match_length - 4;
+    output += static_cast<char>((std::min<size_t>(literal_length, 15) << 4) | std::min<size_t>(match_code, 15));
+
+    // lengths of 15 or more continue in 255 byte steps
+    if (literal_length >= 15)
+    {
+        size_t remaining = literal_length - 15;
+        for (; remaining >= 255; remaining -= 255) {
+            output += static_cast<char>(255);
+        }
+        output += static_cast<char>(remaining);
+    }
+    output.append(literals, literal_length);
+
+    if (offset == 0)
+    {
+        return;
+    }
+
+    output += static_cast<char>(offset);
+    output += static_cast<char>(offset >> 8);
+    if (match_code >= 15)
+    {
+        size_t remaining = match_code - 15;
+        for (; remaining >= 255; remaining -= 255) {
+            output += static_cast<char>(255);
+        }
+        output += static_cast<char>(remaining);
+    }
+}
+
+/// <summary>
+/// compress one block in the lz4 block format with a single-probe hash table (greedy, fast)
+/// </summary>
+/// <param name="source">bytes to compress</param>
+/// <param name="length">number of bytes, at most 64 KiB apart from match distance limits</param>
+/// <param name="hash_table">scratch table of 4096 entries, reused between blocks</param>
+/// <returns>compressed block</returns>
+std::string lz4_compress_block(const char* source, size_t length, std::vector<uint32_t>& hash_table)
+{
+    // lz4 format limits: the last 5 bytes are always literals and the last match
+    // must start at least 12 bytes before the end of the block
+    const size_t last_literals = 5;
+    const size_t match_start_limit = 12;
+
+    std::string output;
+    output.reserve(length + length / 255 + 16);
+
+    size_t anchor = 0;
+    if (length > match_start_limit)
+    {
+        // table entries are position + 1 so a cleared table means no candidate
+        std::fill(hash_table.begin(), hash_table.end(), 0u);
+        const size_t match_end = length - last_literals;
+
+        for (size_t position = 0; position <= length - match_start_limit;) {
+            uint32_t sequence;
+            std::memcpy(&sequence, source + position, sizeof(sequence));
+            const uint32_t hash = (sequence * 2654435761u) >> 20;
+            const size_t candidate = hash_table[hash];
+            hash_table[hash] = static_cast<uint32_t>(position + 1);
+
+            uint32_t candidate_sequence = 0;
+            if (candidate > 0)
+            {
+                std::memcpy(&candidate_sequence, source + candidate - 1, sizeof(candidate_sequence));
+            }
+            if (candidate == 0 || position + 1 - candidate > 65535 || candidate_sequence != sequence)
+            {
+                ++position;
+                continue;
+            }
+
+            const size_t match = candidate - 1;
+            size_t match_length = 4;
+            while (position + match_length < match_end && source[match + match_length] == source[position + match_length]) {
+                ++match_length;
+            }
+
+            lz4_emit_sequence(output, source + anchor, position - anchor, position - match, match_length);
+            position += match_length;
+            anchor = position;
+        }
+    }
+
+    lz4_emit_sequence(output, source + anchor, length - anchor, 0, 0);
+    return output;
+}
+
+/// <summary>
+/// decompress one lz4 block, rejecting any input that would read or write out of bounds
+/// </summary>
+/// <param name="source">compressed block</param>
+/// <param name="length">compressed length</param>
+/// <param name="output">destination buffer</param>
+/// <param name="output_length">exact decompressed size expected</param>
+void lz4_decompress_block(const char* source, size_t length, char* output, size_t output_length)
+{
+    const auto* input = reinterpret_cast<const unsigned char*>(source);
+    size_t in = 0;
+    size_t out = 0;
+
+    auto read_length = [&](size_t value) {
+        if (value == 15)
+        {
+            unsigned char next;
+            do {
+                if (in >= length)
+                {
+                    throw std::runtime_error("lz4_decompress_block: truncated length");
+                }
+                next = input[in++];
+                value += next;
+            } while (next == 255);
+        }
+        return value;
+    };
+
+    while (in < length) {
+        const unsigned char token = input[in++];
+
+        const size_t literal_length = read_length(token >> 4);
+        if (literal_length > length - in || literal_length > output_length - out)
+        {
+            throw std::runtime_error("lz4_decompress_block: literals out of bounds");
+        }
+        std::memcpy(output + out, input + in, literal_length);
+        in += literal_length;
+        out += literal_length;
+
+        // the final sequence has literals only
+        if (in == length)
+        {
+            break;
+        }
+
+        if (length - in < 2)
+        {
+            throw std::runtime_error("lz4_decompress_block: truncated offset");
+        }
+        const size_t offset = input[in] | (input[in + 1] << 8);
+        in += 2;
+        const size_t match_length = read_length(token & 15) + 4;
+        if (offset == 0 || offset > out || match_length > output_length - out)
+        {
+            throw std::runtime_error("lz4_decompress_block: match out of bounds");
+        }
+
+        // matches may overlap the bytes they produce, so copy forward one byte at a time
+        for (size_t i = 0; i < match_length; ++i, ++out) {
+            output[out] = output[out - offset];
+        }
+    }
+
+    if (out != output_length)
+    {
+        throw std::runtime_error("lz4_decompress_block: size mismatch");
+    }
+}
+
+/// <summary>
+/// compress data block by block ahead of encryption.
+/// each block is written as a little-endian length followed by its lz4 block; blocks that do not
+/// shrink are stored as-is with the high bit of the length set.
+/// </summary>
+/// <param name="source">plaintext to compress</param>
+/// <param name="block_size">plaintext bytes per block</param>
+/// <returns>framed compressed data</returns>
+std::string compress_data(const std::string& source, size_t block_size)
+{
+    TRACE_SCOPE("compress_data");
+
+    assert(block_size > 0 && block_size < 0x80000000u);
+
+    std::string output;
+    output.reserve(source.length() / 2);
+    std::vector<uint32_t> hash_table(4096);
+
+    for (size_t begin = 0; begin < source.length(); begin += block_size) {
+        const size_t length = std::min(block_size, source.length() - begin);
+        const std::string block = lz4_compress_block(source.data() + begin, length, hash_table);
+
+        if (block.length() < length)
+        {
+            put_le32(output, static_cast<uint32_t>(block.length()));
+            output += block;
+        }
+        else
+        {
+            put_le32(output, static_cast<uint32_t>(length) | 0x80000000u);
+            output.append(source, begin, length);
+        }
+    }
+
+    return output;
+}
+
+/// <summary>
+/// reverse compress_data after decryption
+/// </summary>
+/// <param name="source">framed compressed data</param>
+/// <param name="block_size">plaintext bytes per block used when compressing</param>
+/// <param name="original_size">plaintext size recorded in the file header</param>
+/// <returns>original plaintext</returns>
+std::string decompress_data(const std::string& source, size_t block_size, size_t original_size)
+{
+    TRACE_SCOPE("decompress_data");
+
+    // a zero block size would never advance through the output
+    if (block_size == 0)
+    {
+        throw std::invalid_argument("decompress_data: block size must be positive");
+    }
+
+    std::string output(original_size, '\0');
+    size_t in = 0;
+
+    for (size_t begin = 0; begin < original_size; begin += block_size) {
+        const size_t length = std::min(block_size, original_size - begin);
+        if (source.length() - in < 4)
+        {
+            throw std::runtime_error("decompress_data: truncated block header");
+        }
+        const uint32_t frame = get_le32(source.data() + in);
+        const size_t stored_length = frame & 0x7FFFFFFFu;
+        in += 4;
+        if (stored_length > source.length() - in)
+        {
+            throw std::runtime_error("decompress_data: truncated block");
+        }
+
+        if (frame & 0x80000000u)
+        {
+            if (stored_length != length)
+            {
+                throw std::runtime_error("decompress_data: stored block size mismatch");
+            }
+            std::memcpy(&output[begin], source.data() + in, length);
+        }
+        else
+        {
+            lz4_decompress_block(source.data() + in, stored_length, &output[begin], length);
+        }
+        in += stored_length;
+    }
+
+    if (in != source.length())
+    {
+        throw std::runtime_error("decompress_data: trailing bytes");
+    }
+    return output;
+}
+
+/// <summary>
+/// common interface for the stream ciphers behind encrypt_decrypt.
+/// encryption and decryption are the same operation: xor with the cipher's keystream.
+/// </summary>
+class cipher_backend
+{
+public:
+    virtual ~cipher_backend() = default;
+
+    /// <summary>
+    /// name recorded in the cipher field of the format line
+    /// </summary>
+    virtual std::string name() const = 0;
+
+    /// <summary>
+    /// xor the keystream for stream bytes [position, position + length) into data
+    /// </summary>
+    /// <param name="data">bytes to transform in place</param>
+    /// <param name="length">number of bytes</param>
+    /// <param name="position">offset of data[0] within the whole stream</param>
+    virtual void apply(char* data, size_t length, uint64_t position) const = 0;
+};
+
+/// <summary>
+/// the original repeating-key xor
+/// </summary>
+class xor_cipher : public cipher_backend
+{
+public:
+    explicit xor_cipher(const std::string& key) : key(key)
+    {
+        assert(!key.empty());
+    }
+
+    std::string name() const override { return "xor"; }
+
+    void apply(char* data, size_t length, uint64_t position) const override
+    {
+        // step the key index instead of taking a modulus per byte
+        const auto key_length = key.length();
+        size_t key_index = static_cast<size_t>(position % key_length);
+        for (size_t i = 0; i < length; ++i) {
+            data[i] ^= key[key_index];
+            if (++key_index == key_length) {
+                key_index = 0;
+            }
+        }
+    }
+
+private:
+    std::string key;
+};
+
+// chacha20 quarter round (rfc 8439 section 2.1), shared by the scalar and simd kernels
+#define CHACHA20_QUARTER_ROUND(ADD, XOR, ROTL, a, b, c, d) \
+    a = ADD(a, b); d = XOR(d, a); d = ROTL(d, 16); \
+    c = ADD(c, d); b = XOR(b, c); b = ROTL(b, 12); \
+    a = ADD(a, b); d = XOR(d, a); d = ROTL(d, 8); \
+    c = ADD(c, d); b = XOR(b, c); b = ROTL(b, 7);
+
+// one column round followed by one diagonal round
+#define CHACHA20_DOUBLE_ROUND(ADD, XOR, ROTL, x) \
+    CHACHA20_QUARTER_ROUND(ADD, XOR, ROTL, x[0], x[4], x[8], x[12]) \
+    CHACHA20_QUARTER_ROUND(ADD, XOR, ROTL, x[1], x[5], x[9], x[13]) \
+    CHACHA20_QUARTER_ROUND(ADD, XOR, ROTL, x[2], x[6], x[10], x[14]) \
+    CHACHA20_QUARTER_ROUND(ADD, XOR, ROTL, x[3], x[7], x[11], x[15]) \
+    CHACHA20_QUARTER_ROUND(ADD, XOR, ROTL, x[0], x[5], x[10], x[15]) \
+    CHACHA20_QUARTER_ROUND(ADD, XOR, ROTL, x[1], x[6], x[11], x[12]) \
+    CHACHA20_QUARTER_ROUND(ADD, XOR, ROTL, x[2], x[7], x[8], x[13]) \
+    CHACHA20_QUARTER_ROUND(ADD, XOR, ROTL, x[3], x[4], x[9], x[14])
+
+#define CHACHA20_ADD32(a, b) ((a) + (b))
+#define CHACHA20_XOR32(a, b) ((a) ^ (b))
+#define CHACHA20_ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+/// <summary>
+/// produce one 64 byte keystream block
+/// </summary>
+/// <param name="input">initial state: constants, key, (ignored) counter, nonce</param>
+/// <param name="counter">block counter</param>
+/// <param name="keystream">receives the serialized block</param>
+void chacha20_block(const uint32_t* input, uint32_t counter, char* keystream)
+{
+    uint32_t x[16];
+    std::memcpy(x, input, sizeof(x));
+    x[12] = counter;
+
+    for (int round = 0; round < 10; ++round) {
+        CHACHA20_DOUBLE_ROUND(CHACHA20_ADD32, CHACHA20_XOR32, CHACHA20_ROTL32, x)
+    }
+
+    for (int i = 0; i < 16; ++i) {
+        const uint32_t word = x[i] + (i == 12 ? counter : input[i]);
+        keystream[4 * i] = static_cast<char>(word);
+        keystream[4 * i + 1] = static_cast<char>(word >> 8);
+        keystream[4 * i + 2] = static_cast<char>(word >> 16);
+        keystream[4 * i + 3] = static_cast<char>(word >> 24);
+    }
+}
+
+#if ENCRYPTION_X86
+#define CHACHA20_ROTL_SSE2(v, n) _mm_or_si128(_mm_slli_epi32(v, n), _mm_srli_epi32(v, 32 - (n)))
+#define CHACHA20_ROTL_AVX2(v, n) _mm256_or_si256(_mm256_slli_epi32(v, n), _mm256_srli_epi32(v, 32 - (n)))
+
+/// <summary>
+/// xor 4 keystream blocks (256 bytes) into data, one block per sse2 lane
+/// </summary>
+/// <param name="input">initial state</param>
+/// <param name="counter">counter of the first block</param>
+/// <param name="data">256 bytes to transform in place</param>
+ENCRYPTION_TARGET("sse2") void chacha20_xor_blocks_sse2(const uint32_t* input, uint32_t counter, char* data)
+{
+    __m128i x[16];
+    __m128i initial[16];
+    for (int i = 0; i < 16; ++i) {
+        initial[i] = _mm_set1_epi32(static_cast<int>(input[i]));
+    }
+    initial[12] = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(counter)), _mm_setr_epi32(0, 1, 2, 3));
+    std::memcpy(x, initial, sizeof(x));
+
+    for (int round = 0; round < 10; ++round) {
+        CHACHA20_DOUBLE_ROUND(_mm_add_epi32, _mm_xor_si128, CHACHA20_ROTL_SSE2, x)
+    }
+
+    // each vector holds one state word of 4 blocks; transpose groups of 4 words back into blocks
+    for (int k = 0; k < 4; ++k) {
+        const __m128i a = _mm_add_epi32(x[4 * k], initial[4 * k]);
+        const __m128i b = _mm_add_epi32(x[4 * k + 1], initial[4 * k + 1]);
+        const __m128i c = _mm_add_epi32(x[4 * k + 2], initial[4 * k + 2]);
+        const __m128i d = _mm_add_epi32(x[4 * k + 3], initial[4 * k + 3]);
+        const __m128i ab_low = _mm_unpacklo_epi32(a, b);
+        const __m128i cd_low = _mm_unpacklo_epi32(c, d);
+        const __m128i ab_high = _mm_unpackhi_epi32(a, b);
+        const __m128i cd_high = _mm_unpackhi_epi32(c, d);
+        const __m128i blocks[4] = {
+            _mm_unpacklo_epi64(ab_low, cd_low), _mm_unpackhi_epi64(ab_low, cd_low),
+            _mm_unpacklo_epi64(ab_high, cd_high), _mm_unpackhi_epi64(ab_high, cd_high) };
+
+        for (int j = 0; j < 4; ++j) {
+            auto* target = reinterpret_cast<__m128i*>(data + 64 * j + 16 * k);
+            _mm_storeu_si128(target, _mm_xor_si128(_mm_loadu_si128(target), blocks[j]));
+        }
+    }
+}
+
+/// <summary>
+/// xor 8 keystream blocks (512 bytes) into data, one block per avx2 lane
+/// </summary>
+/// <param name="input">initial state</param>
+/// <param name="counter">counter of the first block</param>
+/// <param name="data">512 bytes to transform in place</param>
+ENCRYPTION_TARGET("avx2") void chacha20_xor_blocks_avx2(const uint32_t* input, uint32_t counter, char* data)
+{
+    __m256i x[16];
+    __m256i initial[16];
+    for (int i = 0; i < 16; ++i) {
+        initial[i] = _mm256_set1_epi32(static_cast<int>(input[i]));
+    }
+    initial[12] = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(counter)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    std::memcpy(x, initial, sizeof(x));
+
+    for (int round = 0; round < 10; ++round) {
+        CHACHA20_DOUBLE_ROUND(_mm256_add_epi32, _mm256_xor_si256, CHACHA20_ROTL_AVX2, x)
+    }
+
+    // transpose within each 128 bit half: half 0 then holds block j, half 1 holds block j + 4
+    __m256i groups[4][4];
+    for (int k = 0; k < 4; ++k) {
+        const __m256i a = _mm256_add_epi32(x[4 * k], initial[4 * k]);
+        const __m256i b = _mm256_add_epi32(x[4 * k + 1], initial[4 * k + 1]);
+        const __m256i c = _mm256_add_epi32(x[4 * k + 2], initial[4 * k + 2]);
+        const __m256i d = _mm256_add_epi32(x[4 * k + 3], initial[4 * k + 3]);
+        const __m256i ab_low = _mm256_unpacklo_epi32(a, b);
+        const __m256i cd_low = _mm256_unpacklo_epi32(c, d);
+        const __m256i ab_high = _mm256_unpackhi_epi32(a, b);
+        const __m256i cd_high = _mm256_unpackhi_epi32(c, d);
+        groups[k][0] = _mm256_unpacklo_epi64(ab_low, cd_low);
+        groups[k][1] = _mm256_unpackhi_epi64(ab_low, cd_low);
+        groups[k][2] = _mm256_unpacklo_epi64(ab_high, cd_high);
+        groups[k][3] = _mm256_unpackhi_epi64(ab_high, cd_high);
+    }
+
+    // then join matching halves of the four word groups into whole blocks
+    for (int j = 0; j < 4; ++j) {
+        const __m256i blocks[4] = {
+            _mm256_permute2x128_si256(groups[0][j], groups[1][j], 0x20),
+            _mm256_permute2x128_si256(groups[2][j], groups[3][j], 0x20),
+            _mm256_permute2x128_si256(groups[0][j], groups[1][j], 0x31),
+            _mm256_permute2x128_si256(groups[2][j], groups[3][j], 0x31) };
+        char* const targets[4] = { data + 64 * j, data + 64 * j + 32, data + 64 * (j + 4), data + 64 * (j + 4) + 32 };
+
+        for (int i = 0; i < 4; ++i) {
+            auto* target = reinterpret_cast<__m256i*>(targets[i]);
+            _mm256_storeu_si256(target, _mm256_xor_si256(_mm256_loadu_si256(target), blocks[i]));
+        }
+    }
+}
+
+// gcc 12 headers trip -Wuninitialized and -Wmaybe-uninitialized on their own avx-512 placeholder operands
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+/// <summary>
+/// xor 16 keystream blocks (1024 bytes) into data, one block per avx-512 lane
+/// </summary>
+/// <param name="input">initial state</param>
+/// <param name="counter">counter of the first block</param>
+/// <param name="data">1024 bytes to transform in place</param>
+ENCRYPTION_TARGET("avx512f") void chacha20_xor_blocks_avx512(const uint32_t* input, uint32_t counter, char* data)
+{
+    __m512i x[16];
+    __m512i initial[16];
+    for (int i = 0; i < 16; ++i) {
+        initial[i] = _mm512_set1_epi32(static_cast<int>(input[i]));
+    }
+    initial[12] = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(counter)),
+        _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    std::memcpy(x, initial, sizeof(x));
+
+    for (int round = 0; round < 10; ++round) {
+        CHACHA20_DOUBLE_ROUND(_mm512_add_epi32, _mm512_xor_si512, _mm512_rol_epi32, x)
+    }
+
+    // transpose within each 128 bit quarter: quarter q then holds block j + 4q
+    __m512i groups[4][4];
+    for (int k = 0; k < 4; ++k) {
+        const __m512i a = _mm512_add_epi32(x[4 * k], initial[4 * k]);
+        const __m512i b = _mm512_add_epi32(x[4 * k + 1], initial[4 * k + 1]);
+        const __m512i c = _mm512_add_epi32(x[4 * k + 2], initial[4 * k + 2]);
+        const __m512i d = _mm512_add_epi32(x[4 * k + 3], initial[4 * k + 3]);
+        const __m512i ab_low = _mm512_unpacklo_epi32(a, b);
+        const __m512i cd_low = _mm512_unpacklo_epi32(c, d);
+        const __m512i ab_high = _mm512_unpackhi_epi32(a, b);
+        const __m512i cd_high = _mm512_unpackhi_epi32(c, d);
+        groups[k][0] = _mm512_unpacklo_epi64(ab_low, cd_low);
+        groups[k][1] = _mm512_unpackhi_epi64(ab_low, cd_low);
+        groups[k][2] = _mm512_unpacklo_epi64(ab_high, cd_high);
+        groups[k][3] = _mm512_unpackhi_epi64(ab_high, cd_high);
+    }
+
+    // then gather quarter q of the four word groups into block j + 4q
+    for (int j = 0; j < 4; ++j) {
+        const __m512i quarters_01_of_01 = _mm512_shuffle_i32x4(groups[0][j], groups[1][j], 0x44);
+        const __m512i quarters_01_of_23 = _mm512_shuffle_i32x4(groups[2][j], groups[3][j], 0x44);
+        const __m512i quarters_23_of_01 = _mm512_shuffle_i32x4(groups[0][j], groups[1][j], 0xEE);
+        const __m512i quarters_23_of_23 = _mm512_shuffle_i32x4(groups[2][j], groups[3][j], 0xEE);
+        const __m512i blocks[4] = {
+            _mm512_shuffle_i32x4(quarters_01_of_01, quarters_01_of_23, 0x88),
+            _mm512_shuffle_i32x4(quarters_01_of_01, quarters_01_of_23, 0xDD),
+            _mm512_shuffle_i32x4(quarters_23_of_01, quarters_23_of_23, 0x88),
+            _mm512_shuffle_i32x4(quarters_23_of_01, quarters_23_of_23, 0xDD) };
+
+        for (int q = 0; q < 4; ++q) {
+            char* target = data + 64 * (j + 4 * q);
+            _mm512_storeu_si512(target, _mm512_xor_si512(_mm512_loadu_si512(target), blocks[q]));
+        }
+    }
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+/// <summary>
+/// pick the widest chacha20 kernel this cpu can run
+/// </summary>
+/// <returns>number of chacha20 blocks the widest usable kernel processes at once</returns>
+size_t cpu_chacha20_parallel_blocks()
+{
+    return cpu_has_avx512f() ? 16 : cpu_has_avx2() ? 8 : 4;
+}
+#endif
+
+/// <summary>
+/// chacha20 stream cipher (rfc 8439) with a 32 byte key, 12 byte nonce and 32 bit block counter.
+/// keystream is generated 16, 8 or 4 blocks at a time with avx-512, avx2 or sse2 when available.
+/// </summary>
+class chacha20_cipher : public cipher_backend
+{
+public:
+    static constexpr size_t key_size = 32;
+    static constexpr size_t nonce_size = 12;
+
+    /// <summary>
+    /// set up the cipher state
+    /// </summary>
+    /// <param name="key">32 raw key bytes</param>
+    /// <param name="nonce">12 raw nonce bytes, never reused with the same key</param>
+    /// <param name="initial_counter">counter of the first block; rfc 8439 encryption starts at 1</param>
+    /// <param name="max_parallel_blocks">cap on the simd width, 1 forces the scalar path</param>
+    chacha20_cipher(const std::string& key, const std::string& nonce, uint32_t initial_counter = 1, size_t max_parallel_blocks = 16)
+        : initial_counter(initial_counter), parallel_blocks(1)
+    {
+        if (key.length() != key_size)
+        {
+            throw std::invalid_argument("chacha20_cipher: key must be 32 bytes");
+        }
+        if (nonce.length() != nonce_size)
+        {
+            throw std::invalid_argument("chacha20_cipher: nonce must be 12 bytes");
+        }
+
+        // "expand 32-byte k"
+        input[0] = 0x61707865u;
+        input[1] = 0x3320646eu;
+        input[2] = 0x79622d32u;
+        input[3] = 0x6b206574u;
+        for (int i = 0; i < 8; ++i) {
+            input[4 + i] = get_le32(key.data() + 4 * i);
+        }
+        input[12] = 0;
+        for (int i = 0; i < 3; ++i) {
+            input[13 + i] = get_le32(nonce.data() + 4 * i);
+        }
+
+#if ENCRYPTION_X86
+        static const size_t supported_blocks = cpu_chacha20_parallel_blocks();
+        parallel_blocks = std::min(supported_blocks, max_parallel_blocks);
+#else
+        (void)max_parallel_blocks;
+#endif
+    }
+
+    std::string name() const override { return "chacha20"; }
+
+    void apply(char* data, size_t length, uint64_t position) const override
+    {
+        uint64_t block = position / 64;
+        const size_t skip = static_cast<size_t>(position % 64);
+
+        // the 32 bit counter must not wrap within one key and nonce
+        if (initial_counter + block + (skip + length + 63) / 64 > (uint64_t(1) << 32))
+        {
+            throw std::length_error("chacha20_cipher: stream exceeds 256 GiB for one nonce");
+        }
+
+        char keystream[64];
+        if (skip != 0 && length > 0)
+        {
+            const size_t count = std::min(64 - skip, length);
+            chacha20_block(input, counter_for(block), keystream);
+            for (size_t i = 0; i < count; ++i) {
+                data[i] ^= keystream[skip + i];
+            }
+            data += count;
+            length -= count;
+            ++block;
+        }
+
+#if ENCRYPTION_X86
+        for (; parallel_blocks >= 16 && length >= 16 * 64; data += 16 * 64, length -= 16 * 64, block += 16) {
+            chacha20_xor_blocks_avx512(input, counter_for(block), data);
+        }
+        for (; parallel_blocks >= 8 && length >= 8 * 64; data += 8 * 64, length -= 8 * 64, block += 8) {
+            chacha20_xor_blocks_avx2(input, counter_for(block), data);
+        }
+        for (; parallel_blocks >= 4 && length >= 4 * 64; data += 4 * 64, length -= 4 * 64, block += 4) {
+            chacha20_xor_blocks_sse2(input, counter_for(block), data);
+        }
+#endif
+
+        for (; length > 0; ++block) {
+            const size_t count = std::min<size_t>(64, length);
+            chacha20_block(input, counter_for(block), keystream);
+            for (size_t i = 0; i < count; ++i) {
+                data[i] ^= keystream[i];
+            }
+            data += count;
+            length -= count;
+        }
+    }
+
+private:
+    uint32_t counter_for(uint64_t block) const
+    {
+        return static_cast<uint32_t>(initial_counter + block);
+    }
+
+    uint32_t input[16];
+    uint32_t initial_counter;
+    size_t parallel_blocks;
+};
+
+/// <summary>
+/// convert bytes to lowercase hex for the format line
+/// </summary>
+/// <param name="bytes">raw bytes</param>
+/// <returns>hex string, two characters per byte</returns>
+std::string to_hex(const std::string& bytes)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(2 * bytes.length());
+    for (const char c : bytes) {
+        hex += digits[static_cast<unsigned char>(c) >> 4];
+        hex += digits[static_cast<unsigned char>(c) & 15];
+    }
+    return hex;
+}
+
+/// <summary>
+/// reverse to_hex
+/// </summary>
+/// <param name="hex">hex string</param>
+/// <returns>raw bytes</returns>
+std::string from_hex(const std::string& hex)
+{
+    auto digit = [](char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        throw std::invalid_argument("from_hex: invalid hex digit");
+    };
+
+    if (hex.length() % 2 != 0)
+    {
+        throw std::invalid_argument("from_hex: odd length");
+    }
+    std::string bytes(hex.length() / 2, '\0');
+    for (size_t i = 0; i < bytes.length(); ++i) {
+        bytes[i] = static_cast<char>((digit(hex[2 * i]) << 4) | digit(hex[2 * i + 1]));
+    }
+    return bytes;
+}
+
+/// <summary>
+/// generate a random nonce for a new chacha20 encryption
+/// </summary>
+/// <returns>12 random bytes</returns>
+std::string make_nonce()
+{
+    std::random_device random;
+    std::string nonce(chacha20_cipher::nonce_size, '\0');
+    for (auto& c : nonce) {
+        c = static_cast<char>(random());
+    }
+    return nonce;
+}
+
+/// <summary>
+/// create a cipher backend by the name stored in a file header
+/// </summary>
+/// <param name="name">"xor" or "chacha20"</param>
+/// <param name="key">key for the cipher</param>
+/// <param name="nonce">nonce, ignored by xor</param>
+/// <returns>the backend</returns>
+std::unique_ptr<cipher_backend> make_cipher(const std::string& name, const std::string& key, const std::string& nonce)
+{
+    if (name == "xor")
+    {
+        return std::make_unique<xor_cipher>(key);
+    }
+    if (name == "chacha20")
+    {
+        return std::make_unique<chacha20_cipher>(key, nonce);
+    }
+    throw std::invalid_argument("make_cipher: unknown cipher " + name);
+}
+
+/// <summary>
+/// encrypt or decrypt a source string with the given cipher backend
+/// </summary>
+/// <param name="source">input string to process</param>
+/// <param name="cipher">cipher to use in encryption / decryption</param>
+/// <returns>transformed string</returns>
+std::string encrypt_decrypt(const std::string& source, const cipher_backend& cipher)
+{
+    TRACE_SCOPE("encrypt_decrypt");
+
+    const auto source_length = source.length();
+
+    // assert that our input data is good
+    assert(source_length > 0);
+
+    std::string output = source;
+    cipher.apply(&output[0], source_length, 0);
+
+    // assert the length of our encrypted output is equal to the source length
+    assert(output.length() == source_length);
+
+    return output;
+}
+
+/// <summary>
+/// encrypt or decrypt a source string using the provided key
+/// </summary>
+/// <param name="source">input string to process</param>
+/// <param name="key">key to use in encryption / decryption</param>
+/// <returns>transformed string</returns>
+std::string encrypt_decrypt(const std::string& source, const std::string& key)
+{
+    return encrypt_decrypt(source, xor_cipher(key));
+}
+
+/// <summary>
+/// check the chacha20 backend against the rfc 8439 section 2.4.2 test vector on every simd width
+/// </summary>
+/// <returns>true when every kernel produces the expected ciphertext</returns>
+bool chacha20_self_test()
+{
+    std::string key(chacha20_cipher::key_size, '\0');
+    for (size_t i = 0; i < key.length(); ++i) {
+        key[i] = static_cast<char>(i);
+    }
+    const std::string nonce = from_hex("000000000000004a00000000");
+    const std::string plaintext = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen would be it.";
+    const std::string expected = from_hex(
+        "6e2e359a2568f98041ba0728dd0d6981e97e7aec1d4360c20a27afccfd9fae0b"
+        "f91b65c5524733ab8f593dabcd62b3571639d624e65152ab8f530c359f0861d8"
+        "07ca0dbf500d6a6156a38e088a22b65e52bc514d16ccf806818ce91ab7793736"
+        "5af90bbf74a35be6b40b8eedf2785e42874d");
+
+    // the vector is shorter than one simd batch, so also check every kernel against the
+    // verified scalar keystream over a longer stretch starting mid-block
+    const size_t widths[] = { 1, 4, 8, 16 };
+    for (const size_t width : widths) {
+        const chacha20_cipher cipher(key, nonce, 1, width);
+        if (encrypt_decrypt(plaintext, cipher) != expected)
+        {
+            return false;
+        }
+
+        std::string wide(64 * 40 + 7, '\0');
+        std::string scalar = wide;
+        cipher.apply(&wide[0], wide.length(), 5);
+        chacha20_cipher(key, nonce, 1, 1).apply(&scalar[0], scalar.length(), 5);
+        if (wide != scalar)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/// <summary>
+/// optional extensions recorded on the format line of a data file
+/// </summary>
+struct data_file_format
+{
+    // bytes of encrypted payload covered by each crc32c, 0 when the file carries no checksums
+    size_t crc32c_chunk_size = 0;
+    // whether the payload was run through compress_data before encryption
+    bool compressed = false;
+    // plaintext bytes per compressed block
+    size_t compression_block_size = 64 * 1024;
+    // plaintext size before compression, recorded when compressed
+    std::streamoff original_size = 0;
+    // cipher backend the payload is encrypted with, see make_cipher
+    std::string cipher = "xor";
+    // raw nonce bytes for ciphers that take one
+    std::string nonce;
+
+    // a file without extensions is written in the original three line header layout
+    bool is_legacy() const { return crc32c_chunk_size == 0 && !compressed && cipher == "xor"; }
+
+    // header line 3: xor keys are written as is, as in the original layout; other ciphers take
+    // binary keys that may contain newlines, so theirs are hex encoded like the nonce
+    std::string key_line(const std::string& key) const { return cipher == "xor" ? key : to_hex(key); }
+};
+
+/// <summary>
+/// header fields written by save_data_file, plus where the payload sits in the file
+/// </summary>
+struct data_file_header
+{
+    std::string student_name;
+    std::string date;
+    std::string key;
+    data_file_format format;
+    // byte offset of the crc32c table, equal to payload_offset when there is none
+    std::streamoff checksum_offset = 0;
+    // byte offset of the first payload byte
+    std::streamoff payload_offset = 0;
+    // payload length, excluding the trailing newline written by save_data_file
+    std::streamoff payload_size = 0;
+    // header lines ended in "\r\n": the file came from a text mode stream on windows, which
+    // also translated every newline byte in the payload
+    bool text_mode_line_endings = false;
+
+    // number of crc32c chunks the payload is split into
+    size_t chunk_count() const
+    {
+        const auto chunk_size = static_cast<std::streamoff>(format.crc32c_chunk_size);
+        return chunk_size == 0 ? 0 : static_cast<size_t>((payload_size + chunk_size - 1) / chunk_size);
+    }
+};
+
+/// <summary>
+/// a byte range of the payload, relative to the first payload byte
+/// </summary>
+struct data_file_range
+{
+    std::streamoff offset = 0;
+    std::streamoff length = 0;
+};
+
+/// <summary>
+/// compute one crc32c per fixed-size chunk of a buffer
+/// </summary>
+/// <param name="data">payload to checksum</param>
+/// <param name="chunk_size">bytes per chunk, the last chunk may be shorter</param>
+/// <returns>checksums in chunk order</returns>
+std::vector<uint32_t> compute_chunk_checksums(const std::string& data, size_t chunk_size)
+{
+    assert(chunk_size > 0);
+
+    std::vector<uint32_t> checksums;
+    checksums.reserve((data.length() + chunk_size - 1) / chunk_size);
+    for (size_t begin = 0; begin < data.length(); begin += chunk_size) {
+        checksums.push_back(crc32c(data.data() + begin, std::min(chunk_size, data.length() - begin)));
+    }
+    return checksums;
+}
+
+/// <summary>
+/// write a checksum table as little-endian 32 bit values
+/// </summary>
+/// <param name="file_stream">binary stream positioned at the table</param>
+/// <param name="checksums">checksums to write</param>
+void write_checksums(std::ostream& file_stream, const std::vector<uint32_t>& checksums)
+{
+    std::string table;
+    table.reserve(4 * checksums.size());
+    for (const uint32_t checksum : checksums) {
+        put_le32(table, checksum);
+    }
+    file_stream.write(table.data(), static_cast<std::streamsize>(table.length()));
+}
+
+/// <summary>
+/// write the header lines for a data file, with a format line when extensions are used
+/// </summary>
+/// <param name="file_stream">binary stream positioned at the start of the file</param>
+/// <param name="header">header fields; payload_size is recorded on the format line</param>
+void write_data_file_header(std::ostream& file_stream, const data_file_header& header)
+{
+    file_stream << header.student_name << std::endl;
+    file_stream << header.date << std::endl;
+    file_stream << header.format.key_line(header.key) << std::endl;
+
+    if (!header.format.is_legacy())
+    {
+        file_stream << "#format payload=" << header.payload_size;
+        if (header.format.crc32c_chunk_size > 0)
+        {
+            file_stream << " crc32c=" << header.format.crc32c_chunk_size;
+        }
+        if (header.format.compressed)
+        {
+            file_stream << " compression=lz4 block=" << header.format.compression_block_size << " original=" << header.format.original_size;
+        }
+        if (header.format.cipher != "xor")
+        {
+            file_stream << " cipher=" << header.format.cipher << " nonce=" << to_hex(header.format.nonce);
+        }
+        file_stream << std::endl;
+    }
+}
+
+void save_data_file(const std::string& filename, const std::string& student_name, const std::string& key, const std::string& data, const data_file_format& format)
+{
+    TRACE_SCOPE("save_data_file");
+
+    if (format.cipher == "xor" && key.find_first_of("\r\n") != std::string::npos)
+    {
+        throw std::invalid_argument("save_data_file: an xor key cannot contain line breaks");
+    }
+
+    //  file format
+    //  Line 1: student name
+    //  Line 2: timestamp (yyyy-mm-dd)
+    //  Line 3: key used, hex encoded for ciphers other than xor
+    //  Line 4: optional "#format" line, followed by a crc32c per chunk of data when enabled
+    //  Line 4+: data, lz4 compressed before encryption when the format says so
+
+    // Retrieve current timestamp using time(0) since equinox and convert to string
+    //time_t current_time = time(0);
+    std::time_t current_time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    char buf[100] = { 0 };
+    std::strftime(buf, sizeof(buf), "%Y-%m-%d", std::localtime(&current_time));
+
+    data_file_header header;
+    header.student_name = student_name;
+    header.date = buf;
+    header.key = key;
+    header.format = format;
+    header.payload_size = static_cast<std::streamoff>(data.length());
+
+    // Store data to the file with ofstream, binary so encrypted bytes are never newline translated
+    std::ofstream file_stream(filename, std::ios::binary);
+
+    // Write out data to the file and close the stream
+    write_data_file_header(file_stream, header);
+    if (format.crc32c_chunk_size > 0)
+    {
+        write_checksums(file_stream, compute_chunk_checksums(data, format.crc32c_chunk_size));
+    }
+    file_stream << data << std::endl;
+    file_stream.close();
+}
+
+void save_data_file(const std::string& filename, const std::string& student_name, const std::string& key, const std::string& data)
+{
+    save_data_file(filename, student_name, key, data, data_file_format());
+}
+
+/// <summary>
+/// the inverse of load_data_file: compress (when the format asks for it), encrypt with the
+/// format's cipher and save. the fields that depend on the data are filled in here rather than
+/// trusted from the caller: original_size, and a fresh nonce for ciphers that take one.
+/// </summary>
+/// <param name="filename">file to write</param>
+/// <param name="student_name">header line 1</param>
+/// <param name="key">key for the format's cipher</param>
+/// <param name="plaintext">data to store</param>
+/// <param name="format">extensions to use; compressed, block size, checksums and cipher are honored</param>
+void encode_data_file(const std::string& filename, const std::string& student_name, const std::string& key, const std::string& plaintext, data_file_format format)
+{
+    std::string data = plaintext;
+    format.original_size = 0;
+    if (format.compressed)
+    {
+        format.original_size = static_cast<std::streamoff>(plaintext.length());
+        data = compress_data(plaintext, format.compression_block_size);
+    }
+    format.nonce = format.cipher == "xor" ? std::string() : make_nonce();
+    if (!data.empty())
+    {
+        data = encrypt_decrypt(data, *make_cipher(format.cipher, key, format.nonce));
+    }
+    save_data_file(filename, student_name, key, data, format);
+}
+
+/// <summary>
+/// read the header lines of a file written by save_data_file
+/// </summary>
+/// <param name="file_stream">binary stream positioned anywhere in the file</param>
+/// <returns>parsed header with payload offset and size</returns>
+data_file_header read_data_file_header(std::istream& file_stream)
+{
+    data_file_header header;
+
+    file_stream.seekg(0, std::ios::end);
+    const std::streamoff file_size = file_stream.tellg();
+    file_stream.seekg(0, std::ios::beg);
+
+    if (!std::getline(file_stream, header.student_name) ||
+        !std::getline(file_stream, header.date) ||
+        !std::getline(file_stream, header.key))
+    {
+        throw std::runtime_error("read_data_file_header: truncated header");
+    }
+    for (std::string* line : { &header.student_name, &header.date, &header.key }) {
+        if (!line->empty() && line->back() == '\r')
+        {
+            line->pop_back();
+            header.text_mode_line_endings = true;
+        }
+    }
+    if (header.key.empty())
+    {
+        throw std::runtime_error("read_data_file_header: malformed header");
+    }
+
+    const std::string format_marker = "#format ";
+    std::string format_line(format_marker.length(), '\0');
+    const std::streamoff line_offset = file_stream.tellg();
+    file_stream.read(&format_line[0], format_line.length());
+    if (file_stream.gcount() != static_cast<std::streamsize>(format_marker.length()) || format_line != format_marker)
+    {
+        // legacy layout: everything up to the final newline is payload
+        file_stream.clear();
+        file_stream.seekg(line_offset);
+        header.checksum_offset = line_offset;
+        header.payload_offset = line_offset;
+        header.payload_size = file_size - line_offset - 1;
+        if (header.payload_size < 0)
+        {
+            throw std::runtime_error("read_data_file_header: malformed header");
+        }
+        return header;
+    }
+
+    if (!std::getline(file_stream, format_line))
+    {
+        throw std::runtime_error("read_data_file_header: truncated format line");
+    }
+
+    bool has_payload_size = false;
+    std::istringstream fields(format_line);
+    std::string field;
+    while (fields >> field) {
+        const size_t equals = field.find('=');
+        if (equals == std::string::npos)
+        {
+            throw std::runtime_error("read_data_file_header: malformed format field " + field);
+        }
+        const std::string name = field.substr(0, equals);
+        const std::string value = field.substr(equals + 1);
+
+        // fields this build does not know about are ignored
+        if (name == "payload")
+        {
+            header.payload_size = std::stoll(value);
+            has_payload_size = true;
+        }
+        else if (name == "crc32c")
+        {
+            header.format.crc32c_chunk_size = std::stoull(value);
+        }
+        else if (name == "compression")
+        {
+            if (value != "lz4" && value != "none")
+            {
+                throw std::runtime_error("read_data_file_header: unsupported compression " + value);
+            }
+            header.format.compressed = value == "lz4";
+        }
+        else if (name == "block")
+        {
+            header.format.compression_block_size = std::stoull(value);
+            if (header.format.compression_block_size == 0 || header.format.compression_block_size >= 0x80000000u)
+            {
+                throw std::runtime_error("read_data_file_header: invalid compression block size " + value);
+            }
+        }
+        else if (name == "original")
+        {
+            header.format.original_size = std::stoll(value);
+            if (header.format.original_size < 0)
+            {
+                throw std::runtime_error("read_data_file_header: invalid original size " + value);
+            }
+        }
+        else if (name == "cipher")
+        {
+            header.format.cipher = value;
+        }
+        else if (name == "nonce")
+        {
+            header.format.nonce = from_hex(value);
+        }
+    }
+    if (!has_payload_size || header.payload_size < 0)
+    {
+        throw std::runtime_error("read_data_file_header: format line has no payload size");
+    }
+    if (header.format.cipher != "xor")
+    {
+        try
+        {
+            header.key = from_hex(header.key);
+        }
+        catch (const std::invalid_argument&)
+        {
+            throw std::runtime_error("read_data_file_header: key is not hex encoded");
+        }
+    }
+
+    header.checksum_offset = file_stream.tellg();
+    header.payload_offset = header.checksum_offset + static_cast<std::streamoff>(4 * header.chunk_count());
+    return header;
+}
 
 /// <summary>
-/// encrypt or decrypt a source string using the provided key
+/// check every chunk of a data file against its stored crc32c without decrypting anything.
+/// chunks are verified in parallel, each worker reading through its own stream.
 /// </summary>
-/// <param name="source">input string to process</param>
-/// <param name="key">key to use in encryption / decryption</param>
-/// <returns>transformed string</returns>
-std::string encrypt_decrypt(const std::string& source, const std::string& key)
+/// <param name="filename">file written by save_data_file with crc32c chunks enabled</param>
+/// <returns>payload ranges that are corrupt or missing, merged and in order; empty when intact</returns>
+std::vector<data_file_range> verify_data_file(const std::string& filename)
 {
-    // get lengths now instead of calling the function every time.
-    // this would have most likely been inlined by the compiler, but design for perfomance.
-    const auto key_length = key.length();
-    const auto source_length = source.length();
+    TRACE_SCOPE("verify_data_file");
 
-    // assert that our input data is good
-    assert(key_length > 0);
-    assert(source_length > 0);
+    std::ifstream file_stream(filename, std::ios::binary);
+    if (!file_stream)
+    {
+        throw std::runtime_error("verify_data_file: unable to open " + filename);
+    }
 
-    std::string output = source;
+    const data_file_header header = read_data_file_header(file_stream);
+    const auto chunk_size = static_cast<std::streamoff>(header.format.crc32c_chunk_size);
+    if (chunk_size == 0)
+    {
+        throw std::runtime_error("verify_data_file: no checksums in " + filename);
+    }
+
+    // a truncated table leaves the remaining chunks unverifiable, which counts as bad
+    const size_t chunk_count = header.chunk_count();
+    std::string table(4 * chunk_count, '\0');
+    file_stream.seekg(header.checksum_offset);
+    file_stream.read(&table[0], static_cast<std::streamsize>(table.length()));
+    const size_t stored_count = static_cast<size_t>(file_stream.gcount()) / 4;
+    file_stream.close();
+
+    std::vector<char> bad(chunk_count, 0);
+    std::atomic<size_t> next_chunk{ 0 };
+    auto verify_chunks = [&]() {
+        TRACE_SCOPE("verify_data_file worker");
+        std::ifstream chunk_stream(filename, std::ios::binary);
+        std::vector<char> buffer(static_cast<size_t>(chunk_size));
 
-    // Read string character by character
-    for (size_t i = 0; i < source_length; ++i) {
-        // xor based encryption method using modulus
-        output[i] = source[i] ^ key[i % key.length()];
+        for (size_t chunk = next_chunk++; chunk < chunk_count; chunk = next_chunk++) {
+            const std::streamoff begin = static_cast<std::streamoff>(chunk) * chunk_size;
+            const std::streamoff length = std::min(chunk_size, header.payload_size - begin);
+            if (chunk >= stored_count)
+            {
+                bad[chunk] = 1;
+                continue;
+            }
+
+            const uint32_t expected = get_le32(table.data() + 4 * chunk);
+
+            chunk_stream.clear();
+            chunk_stream.seekg(header.payload_offset + begin);
+            chunk_stream.read(buffer.data(), length);
+            bad[chunk] = chunk_stream.gcount() != length || crc32c(buffer.data(), static_cast<size_t>(length)) != expected;
+        }
+    };
+
+    const size_t worker_count = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), chunk_count);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < worker_count; ++i) {
+        workers.emplace_back(verify_chunks);
+    }
+    verify_chunks();
+    for (auto& worker : workers) {
+        worker.join();
     }
 
-    // assert the length of our encrypted output is equal to the source length
-    assert(output.length() == source_length);
+    // merge runs of bad chunks into payload ranges
+    std::vector<data_file_range> bad_ranges;
+    for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+        if (!bad[chunk])
+        {
+            continue;
+        }
+        const std::streamoff begin = static_cast<std::streamoff>(chunk) * chunk_size;
+        const std::streamoff length = std::min(chunk_size, header.payload_size - begin);
+        if (!bad_ranges.empty() && bad_ranges.back().offset + bad_ranges.back().length == begin)
+        {
+            bad_ranges.back().length += length;
+        }
+        else
+        {
+            bad_ranges.push_back({ begin, length });
+        }
+    }
 
-    return output;
+    return bad_ranges;
 }
 
-std::string read_file(const std::string& filename)
+/// <summary>
+/// read a data file back to plaintext using only what its own header records: checks the
+/// checksums, decrypts with the recorded cipher, then undoes the compression
+/// </summary>
+/// <param name="filename">file written by save_data_file</param>
+/// <returns>original plaintext</returns>
+std::string load_data_file(const std::string& filename)
 {
-    //std::string file_text = "John Q. Smith\nThis is my test string";
-    // initialize empty string
-    std::string file_text = "";
-    std::string string;
+    TRACE_SCOPE("load_data_file");
 
-    // Open a file stream with which to read the file
-    std::ifstream file_stream(filename);
+    std::ifstream file_stream(filename, std::ios::binary);
+    if (!file_stream)
+    {
+        throw std::runtime_error("load_data_file: unable to open " + filename);
+    }
 
+    const data_file_header header = read_data_file_header(file_stream);
+    if (header.text_mode_line_endings)
+    {
+        throw std::runtime_error("load_data_file: " + filename + " was written in text mode, its payload newlines were translated");
+    }
 
-    while (std::getline(file_stream, string)) {
-        // Newline separator in file
-        file_text += string + "\n";
+    std::string payload(static_cast<size_t>(header.payload_size), '\0');
+    file_stream.seekg(header.payload_offset);
+    file_stream.read(&payload[0], static_cast<std::streamsize>(payload.length()));
+    if (file_stream.gcount() != static_cast<std::streamsize>(payload.length()))
+    {
+        throw std::runtime_error("load_data_file: " + filename + " is truncated");
+    }
+    file_stream.close();
+
+    if (header.format.crc32c_chunk_size > 0 && !verify_data_file(filename).empty())
+    {
+        throw std::runtime_error("load_data_file: " + filename + " fails its checksums");
+    }
+
+    std::string plaintext = payload.empty() ? payload :
+        encrypt_decrypt(payload, *make_cipher(header.format.cipher, header.key, header.format.nonce));
+    if (header.format.compressed)
+    {
+        plaintext = decompress_data(plaintext, header.format.compression_block_size, static_cast<size_t>(header.format.original_size));
+    }
+    return plaintext;
+}
+
+// longest combined old ^ new pad rekey_data_file will build; past this both keys are applied in turn
+const size_t max_rekey_pad_size = 64u << 20;
+
+/// <summary>
+/// build one period of the combined old ^ new keystream for repeating-key xor.
+/// xoring ciphertext with this pad removes the old key and applies the new one in a single step.
+/// </summary>
+/// <param name="old_key">key the data is currently encrypted with</param>
+/// <param name="new_key">key the data should be encrypted with</param>
+/// <returns>pad whose length is the lcm of both key lengths</returns>
+std::string make_rekey_pad(const std::string& old_key, const std::string& new_key)
+{
+    const auto old_length = old_key.length();
+    const auto new_length = new_key.length();
+
+    assert(old_length > 0);
+    assert(new_length > 0);
+
+    // the combined stream repeats once both keys line up again
+    const auto period = std::lcm(old_length, new_length);
+    if (period > max_rekey_pad_size)
+    {
+        throw std::length_error("make_rekey_pad: combined key period too large");
     }
 
+    std::string pad(period, '\0');
+    for (size_t i = 0; i < period; ++i) {
+        pad[i] = old_key[i % old_length] ^ new_key[i % new_length];
+    }
+
+    return pad;
+}
+
+/// <summary>
+/// change the key of a file written by save_data_file in place and in a single pass.
+/// the payload is never decrypted to plaintext, and the key line in the header is rewritten.
+/// chunk checksums, when present, are updated from the keystream change in the same pass, so a
+/// chunk that was corrupt before the rekey still fails verification after it.
+/// ciphers other than repeating-key xor get a fresh nonce; they, and xor keys whose combined period
+/// is too long for one pad, have both keystreams applied to each chunk in memory.
+/// </summary>
+/// <param name="filename">encrypted file to update</param>
+/// <param name="new_key">key to re-encrypt the payload with</param>
+void rekey_data_file(const std::string& filename, const std::string& new_key)
+{
+    TRACE_SCOPE("rekey_data_file");
+
+    assert(!new_key.empty());
+
+    std::fstream file_stream(filename, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file_stream)
+    {
+        throw std::runtime_error("rekey_data_file: unable to open " + filename);
+    }
+
+    data_file_header header = read_data_file_header(file_stream);
+    if (header.text_mode_line_endings)
+    {
+        // the translated payload no longer lines up with the keystream
+        throw std::runtime_error("rekey_data_file: " + filename + " was written in text mode and cannot be rekeyed in place");
+    }
+    if (header.format.cipher == "xor" && new_key.find_first_of("\r\n") != std::string::npos)
+    {
+        throw std::invalid_argument("rekey_data_file: an xor key cannot contain line breaks");
+    }
+
+    // check everything before writing a byte: stopping part way would leave the payload under two keys
+    file_stream.seekg(0, std::ios::end);
+    if (file_stream.tellg() < header.payload_offset + header.payload_size + 1)
+    {
+        throw std::runtime_error("rekey_data_file: " + filename + " is truncated");
+    }
+
+    // the stored table sits in front of the payload, so the size check above covers it
+    std::string stored_checksums(4 * header.chunk_count(), '\0');
+    file_stream.seekg(header.checksum_offset);
+    file_stream.read(&stored_checksums[0], static_cast<std::streamsize>(stored_checksums.length()));
+
+    // repeating-key xor uses one combined pad unless the two key lengths make its period too long
+    const bool repeating_key = header.format.cipher == "xor";
+    const bool combined_pad = repeating_key && std::lcm(header.key.length(), new_key.length()) <= max_rekey_pad_size;
+    const std::string pad = combined_pad ? make_rekey_pad(header.key, new_key) : std::string();
+    const auto period = pad.length();
+    const std::string new_nonce = repeating_key ? std::string() : make_nonce();
+    const auto old_cipher = make_cipher(header.format.cipher, header.key, header.format.nonce);
+    const auto new_cipher = make_cipher(header.format.cipher, new_key, new_nonce);
+
+    // a key of different length moves the payload; shift toward the end back to front
+    // and toward the start front to back so unread bytes are never overwritten.
+    const std::streamoff shift = static_cast<std::streamoff>(header.format.key_line(new_key).length()) -
+        static_cast<std::streamoff>(header.format.key_line(header.key).length());
+    // payload plus its trailing newline
+    const std::streamoff region_size = header.payload_size + 1;
+    // step in checksum chunks so each one can be recomputed from the buffer
+    const size_t checksum_chunk_size = header.format.crc32c_chunk_size;
+    const std::streamoff chunk_size = checksum_chunk_size > 0 ? static_cast<std::streamoff>(checksum_chunk_size) : 64 * 1024;
+    const std::streamoff chunk_count = (region_size + chunk_size - 1) / chunk_size;
+
+    // crc32c is affine: crc(a ^ b) == crc(a) ^ crc(b) ^ crc(zeros), so each stored checksum is
+    // carried over to the new ciphertext from the change alone, without trusting the old bytes
+    std::vector<uint32_t> checksums(header.chunk_count());
+    std::vector<char> buffer(static_cast<size_t>(chunk_size));
+    std::vector<char> change(static_cast<size_t>(chunk_size));
+    const std::vector<char> zeros(static_cast<size_t>(chunk_size), 0);
+    const uint32_t zeros_checksum = crc32c(zeros.data(), zeros.size());
+    for (std::streamoff n = 0; n < chunk_count; ++n) {
+        const std::streamoff chunk = shift > 0 ? chunk_count - 1 - n : n;
+        const std::streamoff begin = chunk * chunk_size;
+        const std::streamoff length = std::min(chunk_size, region_size - begin);
+
+        file_stream.seekg(header.payload_offset + begin);
+        file_stream.read(buffer.data(), length);
+        if (file_stream.gcount() != length)
+        {
+            throw std::runtime_error("rekey_data_file: short read in " + filename);
+        }
+
+        // old keystream ^ new keystream for the payload bytes; the trailing newline is left alone
+        const size_t payload_bytes = static_cast<size_t>(std::min(length, header.payload_size - begin));
+        if (combined_pad)
+        {
+            size_t pad_index = static_cast<size_t>(begin) % period;
+            for (size_t i = 0; i < payload_bytes; ++i) {
+                change[i] = pad[pad_index];
+                if (++pad_index == period) {
+                    pad_index = 0;
+                }
+            }
+        }
+        else if (payload_bytes > 0)
+        {
+            std::fill(change.begin(), change.begin() + payload_bytes, 0);
+            old_cipher->apply(change.data(), payload_bytes, static_cast<uint64_t>(begin));
+            new_cipher->apply(change.data(), payload_bytes, static_cast<uint64_t>(begin));
+        }
+        for (size_t i = 0; i < payload_bytes; ++i) {
+            buffer[i] ^= change[i];
+        }
+        if (checksum_chunk_size > 0 && payload_bytes > 0)
+        {
+            const uint32_t stored = get_le32(stored_checksums.data() + 4 * chunk);
+            const uint32_t zeros_part = payload_bytes == zeros.size() ? zeros_checksum : crc32c(zeros.data(), payload_bytes);
+            checksums[static_cast<size_t>(chunk)] = stored ^ crc32c(change.data(), payload_bytes) ^ zeros_part;
+        }
+
+        file_stream.seekp(header.payload_offset + shift + begin);
+        file_stream.write(buffer.data(), length);
+    }
+
+    // rewrite the header with the new key in front of the (possibly moved) payload
+    header.key = new_key;
+    if (!repeating_key)
+    {
+        header.format.nonce = new_nonce;
+    }
+    file_stream.seekp(0);
+    write_data_file_header(file_stream, header);
+    write_checksums(file_stream, checksums);
     file_stream.close();
-    return file_text;
+    if (file_stream.fail())
+    {
+        throw std::runtime_error("rekey_data_file: write failed for " + filename);
+    }
+
+    if (shift < 0)
+    {
+        std::filesystem::resize_file(filename, static_cast<std::uintmax_t>(header.payload_offset + shift + region_size));
+    }
 }
 
-std::string get_student_name(const std::string& string_data)
+/// <summary>
+/// header fields of one data file, as indexed by data_file_catalog
+/// </summary>
+struct catalog_entry
 {
+    std::string path;
     std::string student_name;
+    std::string date;
+    // header line 3 as written: hex encoded for files using a cipher other than xor
+    std::string key;
+};
 
-    // find the first newline
-    size_t pos = string_data.find('\n');
-    // did we find a newline
-    if (pos != std::string::npos)
-    { // we did, so copy that substring as the student name
-        student_name = string_data.substr(0, pos);
+/// <summary>
+/// read just the header lines of a data file using small bounded reads; the payload is never touched
+/// </summary>
+/// <param name="filename">file to inspect</param>
+/// <param name="entry">filled with the header fields on success</param>
+/// <returns>false when the file is unreadable or does not start with a save_data_file header</returns>
+bool read_catalog_entry(const std::string& filename, catalog_entry& entry)
+{
+    // headers are a few dozen bytes; give up on anything that has no header within the limit
+    const size_t read_size = 512;
+    const size_t header_limit = 4096;
+
+    std::ifstream file_stream(filename, std::ios::binary);
+    if (!file_stream)
+    {
+        return false;
     }
 
-    return student_name;
+    std::string buffer;
+    size_t newline_count = 0;
+    while (newline_count < 3 && buffer.length() < header_limit) {
+        const size_t old_length = buffer.length();
+        buffer.resize(old_length + read_size);
+        file_stream.read(&buffer[old_length], read_size);
+        buffer.resize(old_length + static_cast<size_t>(file_stream.gcount()));
+        newline_count += static_cast<size_t>(std::count(buffer.begin() + old_length, buffer.end(), '\n'));
+        if (buffer.length() == old_length)
+        {
+            break;
+        }
+    }
+    if (newline_count < 3)
+    {
+        return false;
+    }
+
+    const size_t name_end = buffer.find('\n');
+    const size_t date_end = buffer.find('\n', name_end + 1);
+    const size_t key_end = buffer.find('\n', date_end + 1);
+
+    // files written by the baseline in text mode on windows end every header line with \r\n
+    const auto header_line = [&buffer](size_t begin, size_t end) {
+        if (end > begin && buffer[end - 1] == '\r')
+        {
+            --end;
+        }
+        return buffer.substr(begin, end - begin);
+    };
+    const std::string date = header_line(name_end + 1, date_end);
+    const std::string key = header_line(date_end + 1, key_end);
+
+    // line 2 is always the yyyy-mm-dd timestamp written by save_data_file
+    if (date.length() != 10 || date[4] != '-' || date[7] != '-' ||
+        !std::all_of(date.begin(), date.end(), [](char c) { return c == '-' || (c >= '0' && c <= '9'); }) ||
+        key.empty())
+    {
+        return false;
+    }
+
+    entry.path = filename;
+    entry.student_name = header_line(0, name_end);
+    entry.date = date;
+    entry.key = key;
+    return true;
 }
 
-void save_data_file(const std::string& filename, const std::string& student_name, const std::string& key, const std::string& data)
+/// <summary>
+/// escape tabs, newlines and backslashes so a field fits on one catalog line
+/// </summary>
+/// <param name="field">raw field</param>
+/// <returns>escaped field</returns>
+std::string escape_catalog_field(const std::string& field)
 {
-    //  file format
-    //  Line 1: student name
-    //  Line 2: timestamp (yyyy-mm-dd)
-    //  Line 3: key used
-    //  Line 4+: data
+    std::string escaped;
+    escaped.reserve(field.length());
+    for (const char c : field) {
+        switch (c) {
+        case '\\': escaped += "\\\\"; break;
+        case '\t': escaped += "\\t"; break;
+        case '\n': escaped += "\\n"; break;
+        case '\r': escaped += "\\r"; break;
+        default: escaped += c; break;
+        }
+    }
+    return escaped;
+}
 
-    // Retrieve current timestamp using time(0) since equinox and convert to string
-    //time_t current_time = time(0);
-    std::time_t current_time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-    char buf[100] = { 0 };
-    std::strftime(buf, sizeof(buf), "%Y-%m-%d", std::localtime(&current_time));
+/// <summary>
+/// reverse escape_catalog_field
+/// </summary>
+/// <param name="field">escaped field</param>
+/// <returns>raw field</returns>
+std::string unescape_catalog_field(const std::string& field)
+{
+    std::string raw;
+    raw.reserve(field.length());
+    for (size_t i = 0; i < field.length(); ++i) {
+        if (field[i] != '\\' || i + 1 == field.length())
+        {
+            raw += field[i];
+            continue;
+        }
+        switch (field[++i]) {
+        case 't': raw += '\t'; break;
+        case 'n': raw += '\n'; break;
+        case 'r': raw += '\r'; break;
+        default: raw += field[i]; break;
+        }
+    }
+    return raw;
+}
+
+/// <summary>
+/// in-memory index of data file headers, queryable by student name and date
+/// </summary>
+class data_file_catalog
+{
+public:
+    /// <summary>
+    /// add one entry and index it
+    /// </summary>
+    void add(catalog_entry entry)
+    {
+        const size_t index = entries.size();
+        by_name.emplace(entry.student_name, index);
+        by_date.emplace(entry.date, index);
+        entries.push_back(std::move(entry));
+    }
 
-    // Store data to the file with ofstream
-    std::ofstream file_stream(filename);
+    /// <summary>
+    /// all entries in the order they were added
+    /// </summary>
+    const std::vector<catalog_entry>& all() const { return entries; }
 
-    // Write out data to the file and close the stream
-    file_stream << student_name << std::endl;
-    file_stream << buf << std::endl;
-    file_stream << key << std::endl;
-    file_stream << data << std::endl;
-    file_stream.close();
+    /// <summary>
+    /// entries written for one student
+    /// </summary>
+    std::vector<catalog_entry> find_by_name(const std::string& student_name) const
+    {
+        std::vector<catalog_entry> found;
+        const auto range = by_name.equal_range(student_name);
+        for (auto it = range.first; it != range.second; ++it) {
+            found.push_back(entries[it->second]);
+        }
+        return found;
+    }
+
+    /// <summary>
+    /// entries dated within [first_date, last_date]; yyyy-mm-dd strings sort chronologically
+    /// </summary>
+    std::vector<catalog_entry> find_by_date(const std::string& first_date, const std::string& last_date) const
+    {
+        std::vector<catalog_entry> found;
+        if (last_date < first_date)
+        {
+            return found;
+        }
+        const auto end = by_date.upper_bound(last_date);
+        for (auto it = by_date.lower_bound(first_date); it != end; ++it) {
+            found.push_back(entries[it->second]);
+        }
+        return found;
+    }
+
+    /// <summary>
+    /// persist the catalog as one tab separated line per entry
+    /// </summary>
+    void save(const std::string& filename) const
+    {
+        std::ofstream file_stream(filename, std::ios::binary);
+        file_stream << "#catalog path\tname\tdate\tkey" << '\n';
+        for (const auto& entry : entries) {
+            file_stream << escape_catalog_field(entry.path) << '\t' << escape_catalog_field(entry.student_name) << '\t'
+                << escape_catalog_field(entry.date) << '\t' << escape_catalog_field(entry.key) << '\n';
+        }
+        file_stream.close();
+        if (file_stream.fail())
+        {
+            throw std::runtime_error("data_file_catalog::save: write failed for " + filename);
+        }
+    }
+
+    /// <summary>
+    /// load a catalog written by save
+    /// </summary>
+    static data_file_catalog load(const std::string& filename)
+    {
+        std::ifstream file_stream(filename, std::ios::binary);
+        std::string line;
+        if (!file_stream || !std::getline(file_stream, line) || line.rfind("#catalog", 0) != 0)
+        {
+            throw std::runtime_error("data_file_catalog::load: not a catalog " + filename);
+        }
+
+        data_file_catalog catalog;
+        while (std::getline(file_stream, line)) {
+            std::vector<std::string> fields;
+            size_t begin = 0;
+            for (size_t tab = line.find('\t'); tab != std::string::npos; tab = line.find('\t', begin)) {
+                fields.push_back(unescape_catalog_field(line.substr(begin, tab - begin)));
+                begin = tab + 1;
+            }
+            fields.push_back(unescape_catalog_field(line.substr(begin)));
+            if (fields.size() != 4)
+            {
+                throw std::runtime_error("data_file_catalog::load: malformed line in " + filename);
+            }
+            catalog.add({ fields[0], fields[1], fields[2], fields[3] });
+        }
+        return catalog;
+    }
+
+private:
+    std::vector<catalog_entry> entries;
+    std::multimap<std::string, size_t> by_name;
+    std::multimap<std::string, size_t> by_date;
+};
+
+/// <summary>
+/// build a catalog of every data file in a directory, reading headers on parallel worker threads
+/// </summary>
+/// <param name="directory">directory to scan</param>
+/// <param name="recursive">also scan subdirectories</param>
+/// <returns>catalog of the files that carry a save_data_file header, in directory order</returns>
+data_file_catalog scan_data_files(const std::string& directory, bool recursive)
+{
+    TRACE_SCOPE("scan_data_files");
+
+    std::vector<std::string> paths;
+    auto collect = [&paths](const std::filesystem::directory_entry& item) {
+        std::error_code error;
+        if (item.is_regular_file(error))
+        {
+            paths.push_back(item.path().string());
+        }
+    };
+    if (recursive)
+    {
+        for (const auto& item : std::filesystem::recursive_directory_iterator(directory, std::filesystem::directory_options::skip_permission_denied)) {
+            collect(item);
+        }
+    }
+    else
+    {
+        for (const auto& item : std::filesystem::directory_iterator(directory)) {
+            collect(item);
+        }
+    }
+
+    // each worker claims the next unread path; opening files dominates, so use more
+    // workers than cores to keep several reads in flight
+    std::vector<catalog_entry> entries(paths.size());
+    std::vector<char> found(paths.size(), 0);
+    std::atomic<size_t> next_path{ 0 };
+    auto read_headers = [&]() {
+        TRACE_SCOPE("scan_data_files worker");
+        for (size_t i = next_path++; i < paths.size(); i = next_path++) {
+            found[i] = read_catalog_entry(paths[i], entries[i]);
+        }
+    };
+
+    const size_t worker_count = std::min<size_t>(4 * std::max(1u, std::thread::hardware_concurrency()), paths.size());
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < worker_count; ++i) {
+        workers.emplace_back(read_headers);
+    }
+    read_headers();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    data_file_catalog catalog;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (found[i])
+        {
+            catalog.add(std::move(entries[i]));
+        }
+    }
+    return catalog;
+}
+
+/// <summary>
+/// why an audit did or did not produce a key
+/// </summary>
+enum class xor_audit_status
+{
+    // a key was recovered from the payload
+    recovered,
+    // the payload is compressed or not repeating-key xor, so the attack does not apply
+    not_applicable,
+    // the payload is too short to tell any key length apart
+    too_short,
+    // the file could not be opened or its header did not parse; see error
+    failed
+};
+
+/// <summary>
+/// outcome of auditing one data file's repeating-key xor
+/// </summary>
+struct xor_audit_result
+{
+    std::string path;
+    xor_audit_status status = xor_audit_status::failed;
+    // exception message when status is failed
+    std::string error;
+    size_t key_length = 0;
+    std::string recovered_key;
+    // the recovered key is exactly the key stored in the header
+    bool matches_header_key = false;
+};
+
+/// <summary>
+/// count equal bytes between data and itself shifted by a key length candidate
+/// </summary>
+/// <param name="data">ciphertext</param>
+/// <param name="length">ciphertext length, greater than shift</param>
+/// <param name="shift">candidate key length</param>
+/// <returns>number of i with data[i] == data[i + shift]</returns>
+uint64_t shifted_equal_bytes_portable(const char* data, size_t length, size_t shift)
+{
+    uint64_t equal_bytes = 0;
+    for (size_t i = 0; i + shift < length; ++i) {
+        equal_bytes += data[i] == data[i + shift];
+    }
+    return equal_bytes;
+}
+
+#if ENCRYPTION_X86
+/// <summary>
+/// shifted_equal_bytes_portable 32 bytes at a time with cmpeq + movemask
+/// </summary>
+ENCRYPTION_TARGET("avx2") uint64_t shifted_equal_bytes_avx2(const char* data, size_t length, size_t shift)
+{
+    const size_t count = length - shift;
+    uint64_t equal_bytes = 0;
+
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + shift));
+        equal_bytes += std::bitset<32>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)))).count();
+    }
+
+    return equal_bytes + shifted_equal_bytes_portable(data + i, length - i, shift);
+}
+#endif
+
+/// <summary>
+/// how clearly the shifts that are multiples of a candidate key length coincide more often than
+/// the other shifts: a two sample t statistic over the per-shift coincidence rates
+/// </summary>
+/// <param name="coincidence">fraction of equal bytes at each shift, indexed by shift</param>
+/// <param name="key_length">candidate key length</param>
+/// <param name="first_shift">smallest shift to include</param>
+/// <returns>t statistic, 0 when either group is empty</returns>
+double key_length_separation(const std::vector<double>& coincidence, size_t key_length, size_t first_shift)
+{
+    double sums[2] = { 0.0, 0.0 };
+    size_t counts[2] = { 0, 0 };
+    for (size_t shift = first_shift; shift < coincidence.size(); ++shift) {
+        const int aligned = shift % key_length == 0;
+        sums[aligned] += coincidence[shift];
+        ++counts[aligned];
+    }
+    if (counts[0] == 0 || counts[1] == 0)
+    {
+        return 0.0;
+    }
+
+    const double means[2] = { sums[0] / counts[0], sums[1] / counts[1] };
+    double squares = 0.0;
+    for (size_t shift = first_shift; shift < coincidence.size(); ++shift) {
+        const double deviation = coincidence[shift] - means[shift % key_length == 0];
+        squares += deviation * deviation;
+    }
+    const double pooled_deviation = std::sqrt(squares / std::max<double>(1.0, static_cast<double>(counts[0] + counts[1]) - 2.0));
+    const double separation = means[1] - means[0];
+    if (pooled_deviation == 0.0)
+    {
+        return separation > 0.0 ? std::numeric_limits<double>::infinity() : 0.0;
+    }
+    return separation / (pooled_deviation * std::sqrt(1.0 / counts[0] + 1.0 / counts[1]));
+}
+
+/// <summary>
+/// estimate the key length of repeating-key xor ciphertext.
+/// bytes one key length apart were xored with the same key byte, so they coincide as often as
+/// plaintext bytes do; other shifts mix two key bytes and coincide less. every multiple of the
+/// key length coincides too, so each candidate is scored by how well "multiple of the candidate"
+/// splits the high shifts from the low ones, which a multiple of the key length does worse than
+/// the key length itself. when no candidate splits them significantly the key is one byte.
+/// </summary>
+/// <param name="ciphertext">payload encrypted from stream position 0</param>
+/// <param name="max_key_length">longest key length to consider</param>
+/// <returns>likely key length, 0 when the ciphertext is too short to tell</returns>
+size_t find_xor_key_length(const std::string& ciphertext, size_t max_key_length)
+{
+    // shifts 1 and 2 are left out: adjacent plaintext bytes rarely repeat whatever the key, so
+    // they would make every length look periodic
+    const size_t first_shift = 3;
+    // smallest t statistic taken as a real key length rather than noise
+    const double min_separation = 4.0;
+
+    max_key_length = std::min(max_key_length, ciphertext.length() / 4);
+    if (max_key_length <= first_shift)
+    {
+        return 0;
+    }
+
+#if ENCRYPTION_X86
+    static const bool avx2 = cpu_has_avx2();
+#endif
+    std::vector<double> coincidence(max_key_length + 1, 0.0);
+    for (size_t shift = first_shift; shift <= max_key_length; ++shift) {
+#if ENCRYPTION_X86
+        const uint64_t equal_bytes = avx2 ? shifted_equal_bytes_avx2(ciphertext.data(), ciphertext.length(), shift) :
+            shifted_equal_bytes_portable(ciphertext.data(), ciphertext.length(), shift);
+#else
+        const uint64_t equal_bytes = shifted_equal_bytes_portable(ciphertext.data(), ciphertext.length(), shift);
+#endif
+        coincidence[shift] = static_cast<double>(equal_bytes) / static_cast<double>(ciphertext.length() - shift);
+    }
+
+    size_t best_length = 1;
+    double best_separation = min_separation;
+    for (size_t length = 2; length <= max_key_length; ++length) {
+        const double separation = key_length_separation(coincidence, length, first_shift);
+        if (separation > best_separation)
+        {
+            best_separation = separation;
+            best_length = length;
+        }
+    }
+    return best_length;
+}
+
+/// <summary>
+/// score table for guessing plaintext bytes: english letter frequencies, small credit for other
+/// printable text, a penalty for control and non-ascii bytes
+/// </summary>
+static const std::array<double, 256> english_byte_score = [] {
+    std::array<double, 256> score{};
+    score.fill(-5.0);
+    for (int c = 0x20; c < 0x7F; ++c) {
+        score[c] = 0.5;
+    }
+    score['\n'] = 1.0;
+    score[' '] = 13.0;
+
+    const double letter_percent[26] = {
+        8.2, 1.5, 2.8, 4.3, 12.7, 2.2, 2.0, 6.1, 7.0, 0.15, 0.8, 4.0, 2.4,
+        6.7, 7.5, 1.9, 0.1, 6.0, 6.3, 9.1, 2.8, 1.0, 2.4, 0.15, 2.0, 0.07 };
+    for (int letter = 0; letter < 26; ++letter) {
+        score['a' + letter] = letter_percent[letter];
+        score['A' + letter] = 0.5 + letter_percent[letter] / 4;
+    }
+    return score;
+}();
+
+/// <summary>
+/// recover each key byte by scoring every candidate against the bytes it encrypted
+/// </summary>
+/// <param name="ciphertext">payload encrypted from stream position 0</param>
+/// <param name="key_length">key length from find_xor_key_length</param>
+/// <returns>most likely key, shortened to its period when the length was a multiple</returns>
+std::string recover_xor_key(const std::string& ciphertext, size_t key_length)
+{
+    assert(key_length > 0);
+
+    std::string key(key_length, '\0');
+    for (size_t column = 0; column < key_length; ++column) {
+        // score from a histogram so each candidate costs 256 steps instead of a pass over the column
+        std::array<uint64_t, 256> histogram{};
+        for (size_t i = column; i < ciphertext.length(); i += key_length) {
+            ++histogram[static_cast<unsigned char>(ciphertext[i])];
+        }
+
+        double best_score = -1e300;
+        for (int candidate = 0; candidate < 256; ++candidate) {
+            double score = 0.0;
+            for (int c = 0; c < 256; ++c) {
+                score += histogram[c] * english_byte_score[c ^ candidate];
+            }
+            if (score > best_score)
+            {
+                best_score = score;
+                key[column] = static_cast<char>(candidate);
+            }
+        }
+    }
+
+    // a multiple of the real key length recovers the key repeated; keep one period
+    for (size_t period = 1; period < key_length; ++period) {
+        if (key_length % period == 0 && key.compare(period, key_length - period, key, 0, key_length - period) == 0)
+        {
+            return key.substr(0, period);
+        }
+    }
+    return key;
+}
+
+/// <summary>
+/// attempt to break the repeating-key xor of one data file from its payload alone
+/// </summary>
+/// <param name="filename">file written by save_data_file</param>
+/// <param name="max_key_length">longest key length to consider</param>
+/// <param name="sample_size">payload bytes analyzed; a few MiB is plenty for statistics</param>
+/// <returns>audit result; unreadable or malformed files throw</returns>
+xor_audit_result audit_xor_data_file(const std::string& filename, size_t max_key_length, size_t sample_size)
+{
+    TRACE_SCOPE("audit_xor_data_file");
+
+    std::ifstream file_stream(filename, std::ios::binary);
+    if (!file_stream)
+    {
+        throw std::runtime_error("audit_xor_data_file: unable to open " + filename);
+    }
+    const data_file_header header = read_data_file_header(file_stream);
+
+    xor_audit_result result;
+    result.path = filename;
+    if (header.format.cipher != "xor" || header.format.compressed)
+    {
+        result.status = xor_audit_status::not_applicable;
+        return result;
+    }
+
+    // the sample starts at payload position 0 so recovered key bytes line up with the key
+    std::string sample(static_cast<size_t>(std::min<std::streamoff>(header.payload_size, static_cast<std::streamoff>(sample_size))), '\0');
+    file_stream.seekg(header.payload_offset);
+    file_stream.read(&sample[0], static_cast<std::streamsize>(sample.length()));
+    sample.resize(static_cast<size_t>(file_stream.gcount()));
+
+    result.key_length = find_xor_key_length(sample, max_key_length);
+    if (result.key_length == 0)
+    {
+        result.status = xor_audit_status::too_short;
+        return result;
+    }
+    result.status = xor_audit_status::recovered;
+    result.recovered_key = recover_xor_key(sample, result.key_length);
+    result.key_length = result.recovered_key.length();
+    result.matches_header_key = result.recovered_key == header.key;
+    return result;
+}
+
+/// <summary>
+/// audit many data files in parallel, one file per worker at a time
+/// </summary>
+/// <param name="paths">files written by save_data_file</param>
+/// <param name="max_key_length">longest key length to consider</param>
+/// <returns>one result per path, in the same order; files that fail to parse are marked failed with the error</returns>
+std::vector<xor_audit_result> audit_xor_data_files(const std::vector<std::string>& paths, size_t max_key_length)
+{
+    const size_t sample_size = 4 << 20;
+
+    std::vector<xor_audit_result> results(paths.size());
+    std::atomic<size_t> next_path{ 0 };
+    auto audit_files = [&]() {
+        for (size_t i = next_path++; i < paths.size(); i = next_path++) {
+            try {
+                results[i] = audit_xor_data_file(paths[i], max_key_length, sample_size);
+            }
+            catch (const std::exception& exception) {
+                results[i].path = paths[i];
+                results[i].status = xor_audit_status::failed;
+                results[i].error = exception.what();
+            }
+        }
+    };
+
+    const size_t worker_count = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), paths.size());
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < worker_count; ++i) {
+        workers.emplace_back(audit_files);
+    }
+    audit_files();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return results;
 }
 
+#ifndef ENCRYPTION_XOR_NO_MAIN
 int main()
 {
-    std::cout << "Encyption Decryption Test!" << std::endl;
+    log_info("Encyption Decryption Test!");
 
     // input file format
     // Line 1: <students name>
@@ -134,10 +2291,82 @@ int main()
     // save decrypted_string to file
     save_data_file(decrypted_file_name, student_name, key, decrypted_string);
 
-    std::cout << "Read File: " << file_name << " - Encrypted To: " << encrypted_file_name << " - Decrypted To: " << decrypted_file_name << std::endl;
+    // the sse4.2 and portable crc32c must both produce the standard check value
+    assert(~crc32c_portable(~0u, "123456789", 9) == 0xE3069283u);
+#if ENCRYPTION_X86
+    assert(!cpu_has_sse42() || ~crc32c_sse42(~0u, "123456789", 9) == 0xE3069283u);
+#endif
+
+    // the extended format demos write their own files so the submitted files above keep the original layout.
+    // compress the highly redundant text before encrypting it (ciphertext would not compress), and
+    // store a crc32c for every 64 KiB of encrypted output
+    const std::string compressed_file_name = "encrypteddatafile_compressed.txt";
+    data_file_format compressed_format;
+    compressed_format.compressed = true;
+    compressed_format.crc32c_chunk_size = 64 * 1024;
+    encode_data_file(compressed_file_name, student_name, key, source_string, compressed_format);
+
+    // rotate the key of the compressed file in place without writing plaintext anywhere
+    const std::string rotated_key = "correct horse battery staple";
+    rekey_data_file(compressed_file_name, rotated_key);
+
+    // integrity check the rotated file without decrypting it
+    const auto bad_ranges = verify_data_file(compressed_file_name);
+    for (const auto& range : bad_ranges) {
+        log_error("Corrupt payload bytes ", range.offset, "-", (range.offset + range.length - 1), " in ", compressed_file_name);
+    }
+
+    // the file decodes from its own header alone
+    assert(load_data_file(compressed_file_name) == source_string);
+
+    // the chacha20 backend must match rfc 8439 on every simd kernel this cpu supports
+    assert(chacha20_self_test());
+
+    // the cipher is selectable per file; chacha20 and its nonce are recorded in the header
+    const std::string chacha20_file_name = "encrypteddatafile_chacha20.txt";
+    const std::string chacha20_key = "0123456789abcdef0123456789abcdef";
+    data_file_format chacha20_format = compressed_format;
+    chacha20_format.cipher = "chacha20";
+    // like the xor files, the key is stored in cleartext (hex) next to the ciphertext so the
+    // assignment can be graded; anyone holding the file can decrypt it
+    encode_data_file(chacha20_file_name, student_name, chacha20_key, source_string, chacha20_format);
+    assert(load_data_file(chacha20_file_name) == source_string);
+
+    // audit how well the repeating-key xor stands up: break it from the ciphertext alone.
+    // the compressed and chacha20 files are reported as out of scope for this attack.
+    const std::vector<std::string> audited_files = { encrypted_file_name, compressed_file_name, chacha20_file_name };
+    for (const auto& audit : audit_xor_data_files(audited_files, 64)) {
+        switch (audit.status) {
+        case xor_audit_status::recovered:
+            log_info("Audit: ", audit.path, " key length ", audit.key_length, ", recovered key \"", audit.recovered_key, "\"",
+                audit.matches_header_key ? " (matches header key)" : " (differs from header key)");
+            break;
+        case xor_audit_status::not_applicable:
+            log_info("Audit: ", audit.path, " is not plain repeating-key xor, skipped");
+            break;
+        case xor_audit_status::too_short:
+            log_info("Audit: ", audit.path, " payload is too short to find a key length, skipped");
+            break;
+        case xor_audit_status::failed:
+            log_error("Audit: ", audit.path, " could not be read: ", audit.error);
+            break;
+        }
+    }
+
+    // index the headers of every data file next to the program without reading any payload
+    const data_file_catalog catalog = scan_data_files(".", false);
+    catalog.save("datafilecatalog.tsv");
+    log_info("Catalog: ", catalog.all().size(), " data files, ", catalog.find_by_name(student_name).size(), " for ", student_name);
+
+    log_info("Read File: ", file_name, " - Encrypted To: ", encrypted_file_name, " - Decrypted To: ", decrypted_file_name);
+
+    // timeline of the run for chrome://tracing or ui.perfetto.dev
+    trace_write_chrome_json("encryption_trace.json");
 
     // students submit input file, encrypted file, decrypted file, source code file, and key used
 }
 
+#endif
+
 // Run program: Ctrl + F5 or Debug > Start Without Debugging menu
 // Debug program: F5 or Debug > Start Debugging menu
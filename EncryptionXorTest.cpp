@@ -0,0 +1,384 @@
+// EncryptionXorTest.cpp : unit tests for the data file functions in EncryptionXor.cpp
+//
+// Uncomment the next line to use precompiled headers
+//#include "pch.h"
+// uncomment the next line if you do not use precompiled headers
+#include "gtest/gtest.h"
+
+// build the program's functions without its main
+#define ENCRYPTION_XOR_NO_MAIN
+#include "EncryptionXor.cpp"
+
+// helper to make english-like text: common words in random order, with the usual letter frequencies
+std::string english_text(size_t length, unsigned seed)
+{
+    static const char* words[] = { "the", "of", "and", "to", "in", "a", "is", "that", "for", "it", "as", "was", "with", "be", "by",
+        "on", "not", "he", "this", "are", "or", "his", "from", "at", "which", "but", "have", "an", "had", "they", "you", "were",
+        "their", "one", "all", "we", "can", "her", "has", "there", "been", "if", "more", "when", "will", "would", "who", "so", "no",
+        "ship", "harbour", "captain", "sail", "anchor", "treasure", "island", "storm", "crew", "plunder", "galley" };
+    std::mt19937 generator(seed);
+    std::string text;
+    while (text.length() < length) {
+        text += words[generator() % (sizeof(words) / sizeof(words[0]))];
+        text += generator() % 12 == 0 ? ".\n" : " ";
+    }
+    return text.substr(0, length);
+}
+
+// create our test class to house a scratch data file shared by the tests
+class DataFileTest : public ::testing::Test
+{
+protected:
+    const std::string filename = "datafiletest.txt";
+    const std::string key = "password";
+    std::string plaintext;
+
+    void SetUp() override
+    { // a few kilobytes of text so the payload spans several checksum chunks
+        for (int i = 0; i < 100; ++i) {
+            plaintext += "Fire in the hole bowsprit Jack Tar gally holystone " + std::to_string(i) + "\n";
+        }
+    }
+
+    void TearDown() override
+    { // remove the scratch file, if any remains
+        std::remove(filename.c_str());
+    }
+
+    // helper to save the plaintext encrypted with key and a crc32c per 256 bytes of payload
+    void save_checksummed_file()
+    {
+        data_file_format format;
+        format.crc32c_chunk_size = 256;
+        save_data_file(filename, "John Q. Smith", key, encrypt_decrypt(plaintext, key), format);
+    }
+
+    // helper to read the whole file as raw bytes
+    std::string read_bytes() const
+    {
+        std::ifstream file_stream(filename, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file_stream), std::istreambuf_iterator<char>());
+    }
+};
+
+// Test that rekeying an intact checksummed file leaves it verifiable and decryptable with the new key
+TEST_F(DataFileTest, RekeyKeepsChecksumsValid)
+{
+    save_checksummed_file();
+
+    rekey_data_file(filename, "a much longer replacement key");
+
+    ASSERT_TRUE(verify_data_file(filename).empty());
+
+    std::ifstream file_stream(filename, std::ios::binary);
+    const data_file_header header = read_data_file_header(file_stream);
+    std::string payload(static_cast<size_t>(header.payload_size), '\0');
+    file_stream.seekg(header.payload_offset);
+    file_stream.read(&payload[0], header.payload_size);
+
+    ASSERT_EQ(header.key, "a much longer replacement key");
+    ASSERT_EQ(encrypt_decrypt(payload, header.key), plaintext);
+}
+
+// Test that corrupt chunks are reported as exact payload ranges, adjacent chunks merged
+TEST_F(DataFileTest, VerifyReportsMergedBadRanges)
+{
+    data_file_format format;
+    format.crc32c_chunk_size = 100;
+    save_data_file(filename, "John Q. Smith", key, encrypt_decrypt(plaintext.substr(0, 1050), key), format);
+
+    std::string bytes = read_bytes();
+    std::ifstream header_stream(filename, std::ios::binary);
+    const auto payload_offset = static_cast<size_t>(read_data_file_header(header_stream).payload_offset);
+    header_stream.close();
+    for (const size_t offset : { 250, 350, 1049 }) {
+        bytes[payload_offset + offset] ^= 0x01;
+    }
+    {
+        std::ofstream file_stream(filename, std::ios::binary);
+        file_stream << bytes;
+    }
+
+    const auto bad_ranges = verify_data_file(filename);
+
+    // chunks 2 and 3 merge; the last chunk holds only 50 bytes
+    ASSERT_EQ(bad_ranges.size(), 2u);
+    ASSERT_EQ(bad_ranges[0].offset, 200);
+    ASSERT_EQ(bad_ranges[0].length, 200);
+    ASSERT_EQ(bad_ranges[1].offset, 1000);
+    ASSERT_EQ(bad_ranges[1].length, 50);
+}
+
+// Test that a chunk corrupted before a rekey is still reported as corrupt after it
+TEST_F(DataFileTest, RekeyKeepsCorruptChunksDetectable)
+{
+    save_checksummed_file();
+    std::string bytes = read_bytes();
+    std::ifstream header_stream(filename, std::ios::binary);
+    const std::streamoff payload_offset = read_data_file_header(header_stream).payload_offset;
+    header_stream.close();
+    bytes[static_cast<size_t>(payload_offset) + 300] ^= 0x40;
+    {
+        std::ofstream file_stream(filename, std::ios::binary);
+        file_stream << bytes;
+    }
+
+    rekey_data_file(filename, "a much longer replacement key");
+
+    const auto bad_ranges = verify_data_file(filename);
+    ASSERT_EQ(bad_ranges.size(), 1u);
+    ASSERT_EQ(bad_ranges[0].offset, 256);
+    ASSERT_EQ(bad_ranges[0].length, 256);
+}
+
+// Test that rekeying a truncated checksummed file throws and leaves every byte untouched
+// NOTE: This is a negative test
+TEST_F(DataFileTest, RekeyRefusesTruncatedFile)
+{
+    save_checksummed_file();
+    std::filesystem::resize_file(filename, std::filesystem::file_size(filename) - 1000);
+    const std::string before = read_bytes();
+
+    // same length key, so nothing would need to move
+    EXPECT_THROW(rekey_data_file(filename, "drowssap"), std::runtime_error);
+
+    ASSERT_EQ(read_bytes(), before);
+}
+
+// Test that a header written with \r\n line endings is cataloged without the \r
+TEST_F(DataFileTest, CatalogEntryStripsCarriageReturns)
+{
+    {
+        std::ofstream file_stream(filename, std::ios::binary);
+        file_stream << "John Q. Smith\r\n2024-01-31\r\npassword\r\n" << encrypt_decrypt(plaintext, key) << "\r\n";
+    }
+
+    catalog_entry entry;
+    ASSERT_TRUE(read_catalog_entry(filename, entry));
+
+    ASSERT_EQ(entry.student_name, "John Q. Smith");
+    ASSERT_EQ(entry.date, "2024-01-31");
+    ASSERT_EQ(entry.key, "password");
+}
+
+// Test that a date range whose first date is after its last date finds nothing
+// NOTE: This is a negative test
+TEST(DataFileCatalogTest, FindByDateReversedRangeIsEmpty)
+{
+    data_file_catalog catalog;
+    catalog.add({ "a.txt", "John Q. Smith", "2024-01-01", "password" });
+    catalog.add({ "b.txt", "John Q. Smith", "2024-06-01", "password" });
+
+    ASSERT_EQ(catalog.find_by_date("2024-01-01", "2024-12-31").size(), 2u);
+    ASSERT_TRUE(catalog.find_by_date("2024-12-31", "2024-01-01").empty());
+}
+
+// Test that the chacha20 keystream matches the rfc 8439 vectors on every simd kernel this cpu supports;
+// main only checks this with assert, which NDEBUG builds drop
+TEST(ChaCha20Test, MatchesRfc8439)
+{
+    ASSERT_TRUE(chacha20_self_test());
+}
+
+// Test that a binary chacha20 key containing a newline survives the header and a rekey
+TEST_F(DataFileTest, ChaCha20KeyWithNewlineRoundTrips)
+{
+    const std::string binary_key("0123456789abcdef\n\r\0x23456789abcd", 32);
+    data_file_format format;
+    format.crc32c_chunk_size = 256;
+    format.cipher = "chacha20";
+    format.nonce = make_nonce();
+    const chacha20_cipher cipher(binary_key, format.nonce);
+    save_data_file(filename, "John Q. Smith", binary_key, encrypt_decrypt(plaintext, cipher), format);
+
+    ASSERT_EQ(load_data_file(filename), plaintext);
+
+    rekey_data_file(filename, std::string(32, '\n'));
+
+    std::ifstream file_stream(filename, std::ios::binary);
+    ASSERT_EQ(read_data_file_header(file_stream).key, std::string(32, '\n'));
+    file_stream.close();
+    ASSERT_EQ(load_data_file(filename), plaintext);
+}
+
+// Test that an xor key with a line break is refused, since it would split the header line
+// NOTE: This is a negative test
+TEST_F(DataFileTest, XorKeyWithNewlineIsRejected)
+{
+    EXPECT_THROW(save_data_file(filename, "John Q. Smith", "pass\nword", plaintext), std::invalid_argument);
+
+    save_checksummed_file();
+    const std::string before = read_bytes();
+
+    EXPECT_THROW(rekey_data_file(filename, "pass\rword"), std::invalid_argument);
+
+    ASSERT_EQ(read_bytes(), before);
+}
+
+// Test that each reason an audit produces no key is reported with its own status
+TEST_F(DataFileTest, AuditReportsWhyNoKeyWasRecovered)
+{
+    const std::string short_filename = "datafiletest_short.txt";
+    const std::string missing_filename = "datafiletest_missing.txt";
+    save_data_file(filename, "John Q. Smith", key, encrypt_decrypt(english_text(5000, 1), key));
+    save_data_file(short_filename, "John Q. Smith", key, encrypt_decrypt("Aho", key));
+
+    const auto results = audit_xor_data_files({ filename, short_filename, missing_filename }, 64);
+    std::remove(short_filename.c_str());
+
+    ASSERT_EQ(results[0].status, xor_audit_status::recovered);
+    ASSERT_EQ(results[0].recovered_key, key);
+    ASSERT_EQ(results[1].status, xor_audit_status::too_short);
+    ASSERT_EQ(results[2].status, xor_audit_status::failed);
+    ASSERT_FALSE(results[2].error.empty());
+
+    data_file_format format;
+    format.cipher = "chacha20";
+    format.nonce = make_nonce();
+    const std::string chacha20_key(32, 'k');
+    save_data_file(filename, "John Q. Smith", chacha20_key, encrypt_decrypt(plaintext, chacha20_cipher(chacha20_key, format.nonce)), format);
+
+    ASSERT_EQ(audit_xor_data_files({ filename }, 16)[0].status, xor_audit_status::not_applicable);
+}
+
+// helper to make bytes that do not compress
+std::string random_bytes(size_t length, unsigned seed)
+{
+    std::mt19937 generator(seed);
+    std::string bytes(length, '\0');
+    for (auto& c : bytes) {
+        c = static_cast<char>(generator());
+    }
+    return bytes;
+}
+
+// Test that literal runs needing one and two extra length bytes survive a compressed block
+TEST(Lz4Test, LongLiteralRunsRoundTrip)
+{
+    for (const size_t literal_length : { 15, 16, 269, 270, 600 }) {
+        const std::string repeated(2000, 'x');
+        const std::string source = random_bytes(literal_length, 1) + repeated + random_bytes(literal_length, 2) + repeated;
+        const std::string compressed = compress_data(source, 64 * 1024);
+
+        // stored as an lz4 block, not raw
+        ASSERT_EQ(get_le32(compressed.data()) & 0x80000000u, 0u);
+        ASSERT_EQ(decompress_data(compressed, 64 * 1024, source.length()), source);
+    }
+}
+
+// Test that matches overlapping the bytes they produce are copied forward correctly
+TEST(Lz4Test, OverlappingMatchesRoundTrip)
+{
+    std::string source = "abc";
+    for (int i = 0; i < 1000; ++i) {
+        source += "abc";
+    }
+    source += std::string(5000, 'z');
+
+    const std::string compressed = compress_data(source, 4096);
+
+    ASSERT_LT(compressed.length(), source.length() / 10);
+    ASSERT_EQ(decompress_data(compressed, 4096, source.length()), source);
+}
+
+// Test that blocks which do not shrink are stored raw and round trip
+TEST(Lz4Test, IncompressibleBlocksAreStoredRaw)
+{
+    const std::string source = random_bytes(10000, 3);
+    const std::string compressed = compress_data(source, 4096);
+
+    // three blocks, each a 4 byte frame header followed by the raw bytes
+    ASSERT_EQ(compressed.length(), source.length() + 3 * 4);
+    ASSERT_EQ(get_le32(compressed.data()), 4096u | 0x80000000u);
+    ASSERT_EQ(decompress_data(compressed, 4096, source.length()), source);
+}
+
+// Test that every truncation of a frame, and trailing bytes after it, are refused
+// NOTE: This is a negative test
+TEST(Lz4Test, TruncatedFramesThrow)
+{
+    const std::string source = random_bytes(300, 4) + std::string(3000, 'x') + "tail";
+    const std::string compressed = compress_data(source, 1024);
+
+    for (size_t length = 0; length < compressed.length(); ++length) {
+        EXPECT_THROW(decompress_data(compressed.substr(0, length), 1024, source.length()), std::runtime_error);
+    }
+    EXPECT_THROW(decompress_data(compressed + '\0', 1024, source.length()), std::runtime_error);
+}
+
+// Test that corrupt sequences inside a block are refused instead of reading or writing out of bounds
+// NOTE: This is a negative test
+TEST(Lz4Test, CorruptBlocksThrow)
+{
+    char output[16];
+    const auto decode = [&output](const std::string& block, size_t output_length) {
+        lz4_decompress_block(block.data(), block.length(), output, output_length);
+    };
+
+    // one literal, then a match reaching back 5 bytes when only 1 has been written
+    EXPECT_THROW(decode(std::string("\x10" "a" "\x05\x00", 4), 5), std::runtime_error);
+    // offset zero
+    EXPECT_THROW(decode(std::string("\x10" "a" "\x00\x00", 4), 5), std::runtime_error);
+    // literal length continues past the end of the block
+    EXPECT_THROW(decode(std::string("\xF0", 1), 16), std::runtime_error);
+    // more literals than the block holds
+    EXPECT_THROW(decode(std::string("\x50" "ab", 3), 5), std::runtime_error);
+    // more literals than the output holds
+    EXPECT_THROW(decode(std::string("\x30" "abc", 4), 2), std::runtime_error);
+    // match longer than the remaining output
+    EXPECT_THROW(decode(std::string("\x1F" "a" "\x01\x00\x10", 5), 16), std::runtime_error);
+    // missing the second offset byte
+    EXPECT_THROW(decode(std::string("\x10" "a" "\x01", 3), 5), std::runtime_error);
+    // decodes to fewer bytes than the block should hold
+    EXPECT_THROW(decode(std::string("\x20" "ab", 3), 3), std::runtime_error);
+
+    // a frame whose raw block length disagrees with the block size
+    std::string frame;
+    put_le32(frame, 3u | 0x80000000u);
+    frame += "abc";
+    EXPECT_THROW(decompress_data(frame, 4, 4), std::runtime_error);
+}
+
+// Test that encode_data_file fills in the compression fields itself and load_data_file reverses it
+TEST_F(DataFileTest, EncodeThenLoadRoundTrips)
+{
+    for (const std::string cipher : { "xor", "chacha20" }) {
+        data_file_format format;
+        format.compressed = true;
+        format.compression_block_size = 1000;
+        format.crc32c_chunk_size = 256;
+        format.cipher = cipher;
+        const std::string file_key = cipher == "xor" ? key : std::string(32, 'k');
+
+        encode_data_file(filename, "John Q. Smith", file_key, plaintext, format);
+
+        std::ifstream file_stream(filename, std::ios::binary);
+        const data_file_header header = read_data_file_header(file_stream);
+        file_stream.close();
+        ASSERT_EQ(header.format.original_size, static_cast<std::streamoff>(plaintext.length()));
+        ASSERT_LT(header.payload_size, static_cast<std::streamoff>(plaintext.length()));
+        ASSERT_EQ(load_data_file(filename), plaintext);
+    }
+}
+
+// Test that the key length itself is found, not a multiple or a divisor of it, across key lengths and text sizes
+TEST(XorAuditTest, FindsExactKeyLength)
+{
+    for (const std::string key : { "k", "ab", "xyz", "password", "0123456789abcdef", "correct horse battery staple" }) {
+        for (const size_t size : { 2000, 5000, 20000 }) {
+            const std::string ciphertext = encrypt_decrypt(english_text(size, static_cast<unsigned>(size)), key);
+            EXPECT_EQ(find_xor_key_length(ciphertext, 64), key.length()) << "key \"" << key << "\", " << size << " bytes";
+        }
+    }
+}
+
+// Test that a key that is nearly one repeated byte is not mistaken for a shorter one
+TEST(XorAuditTest, FindsNearlyPeriodicKey)
+{
+    const std::string key = "aaaaaaaab";
+    for (const size_t size : { 5000, 20000 }) {
+        const std::string ciphertext = encrypt_decrypt(english_text(size, static_cast<unsigned>(size)), key);
+        ASSERT_EQ(find_xor_key_length(ciphertext, 64), key.length());
+        ASSERT_EQ(recover_xor_key(ciphertext, key.length()), key);
+    }
+}
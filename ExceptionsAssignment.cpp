@@ -3,6 +3,9 @@
 
 #include <iostream>
 
+#include "AsyncLogger.h"
+#include "HotPathTrace.h"
+
 
 // myexception extends from std::exception, allowing a custom message to be returned
 struct myexception : public std::exception {
@@ -18,7 +21,7 @@ bool do_even_more_custom_application_logic()
     // use throw to throw an exception
     throw std::exception();
 
-    std::cout << "Running Even More Custom Application Logic." << std::endl;
+    log_info("Running Even More Custom Application Logic.");
 
     return true;
 }
@@ -27,29 +30,31 @@ void do_custom_application_logic()
     // TODO: Wrap the call to do_even_more_custom_application_logic()
     //  with an exception handler that catches std::exception, displays
     //  a message and the exception.what(), then continues processing
-    std::cout << "Running Custom Application Logic." << std::endl;
+    log_info("Running Custom Application Logic.");
 
     try {
         if (do_even_more_custom_application_logic())
         {
-            std::cout << "Even More Custom Application Logic Succeeded." << std::endl;
+            log_info("Even More Custom Application Logic Succeeded.");
         }
     }
     // catch standard exception and display message
     catch (const std::exception& exception) {
-        std::cerr << "do_custom_application_logic: Error message from exception: " << exception.what() << std::endl;
+        log_error("do_custom_application_logic: Error message from exception: ", exception.what());
     }
     
 
     // TODO: Throw a custom exception derived from std::exception
     //  and catch it explictly in main
     throw myexception();
-    std::cout << "Leaving Custom Application Logic." << std::endl;
+    log_info("Leaving Custom Application Logic.");
 
 }
 
 float divide(float num, float den)
 {
+    TRACE_SCOPE("divide");
+
     // TODO: Throw an exception to deal with divide by zero errors using
     //  a standard C++ defined exception
     if (den == 0) {
@@ -69,10 +74,10 @@ void do_division() noexcept
     // handle division by zero possibility by catching exception
     try {
         auto result = divide(numerator, denominator);
-        std::cout << "divide(" << numerator << ", " << denominator << ") = " << result << std::endl;
+        log_info("divide(", numerator, ", ", denominator, ") = ", result);
     }
     catch (const std::exception& exception) {
-        std::cerr << "do_division(): Exception message: " << exception.what() << std::endl;
+        log_error("do_division(): Exception message: ", exception.what());
     }
     
 }
@@ -80,7 +85,7 @@ void do_division() noexcept
 int main()
 {
     try {
-        std::cout << "Exceptions Tests!" << std::endl;
+        log_info("Exceptions Tests!");
         // TODO: Create exception handlers that catch (in this order):
         //  your custom exception
         //  std::exception
@@ -91,14 +96,17 @@ int main()
     }
     // catch custom exception and display
     catch (const myexception& exception) {
-        std::cerr << "main: Custom Exception has occurred: " << exception.what() << std::endl;
+        log_error("main: Custom Exception has occurred: ", exception.what());
     }
     catch (const std::exception& exception) {
-        std::cerr << "main: Standard Exception has occurred: " << exception.what() << std::endl;
+        log_error("main: Standard Exception has occurred: ", exception.what());
     }
     // catch any unhandled exceptions in post-mortem
     catch (...) {
     }
+
+    // timeline of the run for chrome://tracing or ui.perfetto.dev
+    trace_write_chrome_json("exceptions_trace.json");
 }
 
 // Run program: Ctrl + F5 or Debug > Start Without Debugging menu
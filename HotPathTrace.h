@@ -0,0 +1,260 @@
+// HotPathTrace.h : scoped hot path timers shared by the assignment programs.
+//
+// TRACE_SCOPE("name") records how long the enclosing scope took into a per-thread buffer;
+// trace_write_chrome_json writes every buffer as a Chrome trace (chrome://tracing, Perfetto).
+// When a thread exits its events move into one shared store and its buffer is freed; at most
+// trace_registry::max_events are kept in total, later scopes are only counted.
+// Build with HOTPATH_TRACE_ENABLED=0 to compile every timer out.
+
+#pragma once
+
+#ifndef HOTPATH_TRACE_ENABLED
+#define HOTPATH_TRACE_ENABLED 1
+#endif
+
+#include <string>
+
+#if HOTPATH_TRACE_ENABLED
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <time.h>
+#endif
+
+/// <summary>
+/// monotonic timestamp in nanoseconds; clock_gettime on posix, steady_clock (QueryPerformanceCounter) on windows
+/// </summary>
+inline uint64_t trace_now_ns()
+{
+#if !defined(_WIN32)
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000u + static_cast<uint64_t>(now.tv_nsec);
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+/// <summary>
+/// one completed scope
+/// </summary>
+struct trace_event
+{
+    // must point at a string literal, it is only read at export time
+    const char* name;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+};
+
+/// <summary>
+/// events recorded by one thread; only that thread appends to it
+/// </summary>
+struct trace_buffer
+{
+    unsigned thread_id = 0;
+    std::vector<trace_event> events;
+};
+
+/// <summary>
+/// an event kept after its thread exited, tagged with the thread it came from
+/// </summary>
+struct retired_trace_event
+{
+    unsigned thread_id;
+    trace_event event;
+};
+
+/// <summary>
+/// the buffers of running threads, plus the events of threads that have exited, so export
+/// can find everything
+/// </summary>
+class trace_registry
+{
+public:
+    // events kept across all threads (32 MiB at most); scopes past this are counted and dropped
+    static constexpr size_t max_events = 1u << 20;
+
+    static trace_registry& instance()
+    {
+        static trace_registry registry;
+        return registry;
+    }
+
+    /// <summary>
+    /// store one completed scope in this thread's buffer, unless the event limit is reached
+    /// </summary>
+    void record(const trace_event& event)
+    {
+        if (event_count.fetch_add(1, std::memory_order_relaxed) >= max_events)
+        {
+            return;
+        }
+        local_buffer().events.push_back(event);
+    }
+
+    /// <summary>
+    /// this thread's buffer, registered the first time the thread records an event
+    /// </summary>
+    trace_buffer& local_buffer()
+    {
+        thread_local buffer_owner owner;
+        if (!owner.buffer)
+        {
+            owner.buffer = std::make_unique<trace_buffer>();
+            std::lock_guard<std::mutex> lock(buffers_mutex);
+            owner.buffer->thread_id = ++thread_count;
+            live_buffers.push_back(owner.buffer.get());
+        }
+        return *owner.buffer;
+    }
+
+    /// <summary>
+    /// write all recorded events as chrome trace "complete" events.
+    /// call once the traced threads are idle; buffers are read without locking.
+    /// </summary>
+    /// <param name="filename">json file to write</param>
+    /// <returns>false when the file could not be written</returns>
+    bool write_chrome_json(const std::string& filename)
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        std::ofstream file_stream(filename, std::ios::binary);
+        file_stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+        // timestamps are relative to the first event so the viewer starts at zero
+        uint64_t origin = UINT64_MAX;
+        for (const auto& retired : retired_events) {
+            origin = retired.event.start_ns < origin ? retired.event.start_ns : origin;
+        }
+        for (const auto* buffer : live_buffers) {
+            for (const auto& event : buffer->events) {
+                origin = event.start_ns < origin ? event.start_ns : origin;
+            }
+        }
+
+        const char* separator = "";
+        auto write_event = [&](unsigned thread_id, const trace_event& event) {
+            file_stream << separator << "\n{\"name\":\"";
+            for (const char* c = event.name; *c != '\0'; ++c) {
+                if (*c == '"' || *c == '\\')
+                {
+                    file_stream << '\\';
+                }
+                file_stream << *c;
+            }
+            // chrome expects microseconds; keep nanosecond precision as a fraction
+            file_stream << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread_id
+                << ",\"ts\":" << (event.start_ns - origin) / 1000 << '.' << std::to_string(1000 + (event.start_ns - origin) % 1000).substr(1)
+                << ",\"dur\":" << event.duration_ns / 1000 << '.' << std::to_string(1000 + event.duration_ns % 1000).substr(1) << '}';
+            separator = ",";
+        };
+        for (const auto& retired : retired_events) {
+            write_event(retired.thread_id, retired.event);
+        }
+        for (const auto* buffer : live_buffers) {
+            for (const auto& event : buffer->events) {
+                write_event(buffer->thread_id, event);
+            }
+        }
+
+        file_stream << "\n]";
+        const size_t recorded = event_count.load(std::memory_order_relaxed);
+        if (recorded > max_events)
+        {
+            file_stream << ",\"otherData\":{\"dropped_events\":\"" << recorded - max_events << "\"}";
+        }
+        file_stream << "}\n";
+        file_stream.close();
+        return !file_stream.fail();
+    }
+
+private:
+    /// <summary>
+    /// hands the thread's events to the shared store when the thread exits
+    /// </summary>
+    struct buffer_owner
+    {
+        std::unique_ptr<trace_buffer> buffer;
+
+        ~buffer_owner()
+        {
+            if (buffer)
+            {
+                trace_registry::instance().retire(*buffer);
+            }
+        }
+    };
+
+    trace_registry() = default;
+
+    /// <summary>
+    /// move an exiting thread's events into retired_events and forget its buffer
+    /// </summary>
+    void retire(const trace_buffer& buffer)
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        for (const auto& event : buffer.events) {
+            retired_events.push_back({ buffer.thread_id, event });
+        }
+        live_buffers.erase(std::find(live_buffers.begin(), live_buffers.end(), &buffer));
+    }
+
+    std::mutex buffers_mutex;
+    std::vector<trace_buffer*> live_buffers;
+    std::vector<retired_trace_event> retired_events;
+    unsigned thread_count = 0;
+    std::atomic<size_t> event_count{ 0 };
+};
+
+/// <summary>
+/// raii timer: records the time between construction and destruction under a name
+/// </summary>
+class trace_scope
+{
+public:
+    explicit trace_scope(const char* name) : name(name), start_ns(trace_now_ns()) {}
+
+    ~trace_scope()
+    {
+        const uint64_t end_ns = trace_now_ns();
+        trace_registry::instance().record({ name, start_ns, end_ns - start_ns });
+    }
+
+    trace_scope(const trace_scope&) = delete;
+    trace_scope& operator=(const trace_scope&) = delete;
+
+private:
+    const char* name;
+    uint64_t start_ns;
+};
+
+#define HOTPATH_TRACE_CONCAT_(a, b) a##b
+#define HOTPATH_TRACE_CONCAT(a, b) HOTPATH_TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) trace_scope HOTPATH_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+/// <summary>
+/// export everything traced so far in chrome trace json format
+/// </summary>
+inline bool trace_write_chrome_json(const std::string& filename)
+{
+    return trace_registry::instance().write_chrome_json(filename);
+}
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+
+inline bool trace_write_chrome_json(const std::string&)
+{
+    return true;
+}
+
+#endif
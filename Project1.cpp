@@ -3,6 +3,7 @@
 
 #include <iostream>     // std::cout
 #include <limits>       // std::numeric_limits
+#include "HotPathTrace.h"
 
 /// <summary>
 /// Template function to abstract away the logic of:
@@ -16,6 +17,8 @@
 template <typename T>
 T add_numbers(T const& start, T const& increment, unsigned long int const& steps)
 {
+    TRACE_SCOPE("add_numbers");
+
     // steps is an unsigned long, and our loop variable is also an unsigned long.
     // result is a T type, and starting point for T type is 0.
     // The increment is std::numeric_limits<T>::max()/5, we step 6 times to trigger overflow.
@@ -65,6 +68,7 @@ T add_numbers(T const& start, T const& increment, unsigned long int const& steps
 template <typename T>
 T subtract_numbers(T const& start, T const& decrement, unsigned long int const& steps)
 {
+    TRACE_SCOPE("subtract_numbers");
 
     T result = start;
     T errorSignal = std::numeric_limits<T>::max();
@@ -273,6 +277,9 @@ int main()
 
     std::cout << std::endl << "All Numeric Underflow / Overflow Tests Complete!" << std::endl;
 
+    // timeline of the run for chrome://tracing or ui.perfetto.dev
+    trace_write_chrome_json("numericoverflows_trace.json");
+
     return 0;
 }
 